@@ -0,0 +1,231 @@
+/*
+QN8007 & QN8006 I2C FM Transmitter Library - Bus transport
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+Author: Semir Nouri, December 2024
+
+*/
+
+#include <QN800x_Bus.h>
+
+//-------------------Arduino TwoWire Section--------------------
+
+#ifdef ARDUINO
+
+QN800x_WireBus::QN800x_WireBus(TwoWire &w) : wire(w)
+{
+    sdaPin = 0xFF;
+    sclPin = 0xFF;
+    clock = 0;                              // Keep the clock Wire.begin() sets
+}
+
+void QN800x_WireBus::setRecovery(uint8_t sda, uint8_t scl, uint32_t hz)
+{
+    sdaPin = sda;
+    sclPin = scl;
+    clock = hz;
+}
+
+uint8_t QN800x_WireBus::write(uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t len)
+{
+    wire.beginTransmission(addr);
+    wire.write(reg);                        // Start sub address
+    wire.write(data, len);
+    return wire.endTransmission();
+}
+
+uint8_t QN800x_WireBus::read(uint8_t addr, uint8_t reg, uint8_t *data, uint8_t len)
+{
+    wire.beginTransmission(addr);
+    wire.write(reg);                        // Set start register address
+    if (wire.endTransmission(false) != 0) return 0; // Repeated start, keep the bus
+
+    uint8_t n = wire.requestFrom(addr, len);
+    for (uint8_t i = 0; i < n; i++) {data[i] = wire.read();}
+    return n;                               // Number of registers actually read
+}
+
+bool QN800x_WireBus::recover() // Clock out a slave that holds SDA low, then restart Wire
+{
+    bool free = true;
+
+    wire.end();
+
+    if (sdaPin != 0xFF && sclPin != 0xFF)
+    {
+        /* A slave interrupted in the middle of a byte waits for the rest of its clocks.
+         * Up to 9 SCL pulses let it finish the byte and see a NACK, a STOP condition
+         * then releases the bus. Open drain is emulated: low = OUTPUT, high = INPUT_PULLUP.
+         */
+
+        pinMode(sdaPin, INPUT_PULLUP);
+        pinMode(sclPin, INPUT_PULLUP);
+
+        for (uint8_t i = 0; i < 9 && !digitalRead(sdaPin); i++)
+        {
+            pinMode(sclPin, OUTPUT);
+            digitalWrite(sclPin, LOW);
+            delayMicroseconds(5);
+            pinMode(sclPin, INPUT_PULLUP);
+            delayMicroseconds(5);
+        }
+
+        pinMode(sdaPin, OUTPUT);            // STOP: SDA low to high while SCL is high
+        digitalWrite(sdaPin, LOW);
+        delayMicroseconds(5);
+        pinMode(sdaPin, INPUT_PULLUP);
+        delayMicroseconds(5);
+
+        free = digitalRead(sdaPin) && digitalRead(sclPin);
+    }
+
+    wire.begin();
+    if (clock) wire.setClock(clock);
+
+    return free;
+}
+
+#endif
+
+//-------------------I2C Multiplexer Section--------------------
+
+QN800x_Mux::QN800x_Mux(QN800x_Bus &b, uint8_t addr) : bus(b)
+{
+    address = addr;
+    current = 0;
+    known = false;                          // State of the mux after power up is not trusted
+    selects = 0;
+}
+
+uint8_t QN800x_Mux::select(uint8_t mask)
+{
+    if (known && mask == current) return 0; // Already enabled, no transaction
+
+    selects++;
+    uint8_t status = bus.write(address, mask, NULL, 0); // The control byte is the only byte
+    known = (status == 0);
+    current = mask;
+    return status;
+}
+
+void QN800x_Mux::invalidate()
+{
+    known = false;
+}
+
+uint32_t QN800x_Mux::getSelects()
+{
+    return selects;
+}
+
+QN800x_MuxPort::QN800x_MuxPort(QN800x_Mux &m, uint8_t chmask) : mux(m)
+{
+    mask = chmask;
+}
+
+uint8_t QN800x_MuxPort::write(uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t len)
+{
+    uint8_t status = mux.select(mask);
+    if (status) return status;
+    return mux.bus.write(addr, reg, data, len);
+}
+
+uint8_t QN800x_MuxPort::read(uint8_t addr, uint8_t reg, uint8_t *data, uint8_t len)
+{
+    if (mask & (mask - 1)) return 0;        // Several QN800x would answer at once
+    if (mux.select(mask)) return 0;
+    return mux.bus.read(addr, reg, data, len);
+}
+
+bool QN800x_MuxPort::recover()
+{
+    mux.invalidate();                       // The mux may have been reset with the bus
+    return mux.bus.recover();
+}
+
+void QN800x_MuxPort::setMask(uint8_t chmask)
+{
+    mask = chmask;
+}
+
+uint8_t QN800x_MuxPort::getMask()
+{
+    return mask;
+}
+
+//-------------------Linux i2c-dev Section----------------------
+
+#if defined(__linux__) && !defined(ARDUINO)
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+QN800x_LinuxBus::QN800x_LinuxBus()
+{
+    fd = -1;
+}
+
+QN800x_LinuxBus::~QN800x_LinuxBus()
+{
+    close();
+}
+
+bool QN800x_LinuxBus::open(const char *device)
+{
+    close();
+    fd = ::open(device, O_RDWR);
+    return fd >= 0;
+}
+
+void QN800x_LinuxBus::close()
+{
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+uint8_t QN800x_LinuxBus::write(uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t len)
+{
+    uint8_t out[33];                        // Sub address plus the largest QN800x burst
+
+    if (fd < 0 || len > 32) return 4;
+
+    out[0] = reg;
+    if (len) memcpy(out + 1, data, len);    // A mux select has no data bytes
+
+    struct i2c_msg msg = {addr, 0, (uint16_t) (len + 1), out};
+    struct i2c_rdwr_ioctl_data xfer = {&msg, 1};
+
+    return ioctl(fd, I2C_RDWR, &xfer) == 1 ? 0 : 2; // The adapter can't tell address from data NACK
+}
+
+uint8_t QN800x_LinuxBus::read(uint8_t addr, uint8_t reg, uint8_t *data, uint8_t len)
+{
+    if (fd < 0) return 0;
+
+    struct i2c_msg msg[2] = 
+    {
+        {addr, 0, 1, &reg},                 // Set start register address
+        {addr, I2C_M_RD, len, data}         // Repeated start and read
+    };
+    struct i2c_rdwr_ioctl_data xfer = {msg, 2};
+
+    return ioctl(fd, I2C_RDWR, &xfer) == 2 ? len : 0;
+}
+
+#endif
@@ -0,0 +1,159 @@
+/*
+QN8007 & QN8006 I2C FM Transmitter Library - Bus transport
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+QN800x_TX talks to the chip only through a QN800x_Bus. Available transports:
+
+QN800x_WireBus   Arduino TwoWire (Wire, Wire1...), used by QN800x_TX() by default
+QN800x_LinuxBus  Linux /dev/i2c-N through the i2c-dev ioctl interface
+QN800x_SimBus    Simulated QN8006/QN8007 in RAM, see QN800x_Sim.h
+QN800x_MuxPort   One or more channels of a TCA9548 style I2C multiplexer. All QN800x
+                 answer to 0x2B, behind a mux each one gets its own port
+
+Author: Semir Nouri, December 2024
+
+*/
+
+#ifndef QN800x_Bus_h
+#define QN800x_Bus_h
+
+#include <QN800x_Port.h>
+
+#ifdef ARDUINO
+#include <Wire.h>
+#endif
+
+class QN800x_Bus
+{
+
+public:
+
+    // Write len bytes from data to the registers starting at reg. Returns 0 on success
+    // or an error code like Wire.endTransmission(): 2 = address NACK, 3 = data NACK, 4 = other
+    virtual uint8_t write(uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t len) = 0;
+
+    // Read len registers starting at reg into data. Returns the number of bytes read
+    virtual uint8_t read(uint8_t addr, uint8_t reg, uint8_t *data, uint8_t len) = 0;
+
+    // Free a hung bus, e.g. a slave holding SDA low. Returns true if the bus may be used again
+    virtual bool recover() {return false;}
+
+};
+
+
+#ifdef ARDUINO
+
+class QN800x_WireBus : public QN800x_Bus
+{
+
+public:
+
+    QN800x_WireBus(TwoWire &wire);
+
+    uint8_t write(uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t len);
+    uint8_t read(uint8_t addr, uint8_t reg, uint8_t *data, uint8_t len);
+    bool recover();
+
+    void setRecovery(uint8_t sda, uint8_t scl, uint32_t clock); // Pins to clock out a hung bus, I2C clock after recovery (0 = Wire default)
+
+private:
+
+    TwoWire &wire;              // I2C port the QN800x is connected to
+    uint8_t sdaPin;             // SDA pin for bus recovery, 0xFF = unknown
+    uint8_t sclPin;             // SCL pin for bus recovery, 0xFF = unknown
+    uint32_t clock;             // I2C clock after recovery, 0 = Wire default
+
+};
+
+#endif
+
+
+/* TCA9548 style multiplexer: one control byte at the mux address enables any
+ * combination of its 8 channels. The mux remembers the last selection, so a port
+ * whose channels are already enabled costs no extra transaction. A port with
+ * several channels writes to all QN800x on them at once, but can't read.
+ */
+
+class QN800x_Mux
+{
+
+public:
+
+    QN800x_Mux(QN800x_Bus &bus, uint8_t address = 0x70);
+
+    uint8_t select(uint8_t mask);   // Enable the channels in mask, skipped if already enabled
+    void invalidate();              // Selection unknown, e.g. after a bus recovery
+    uint32_t getSelects();          // Number of select transactions sent
+
+    QN800x_Bus &bus;                // Bus the mux is connected to
+
+private:
+
+    uint8_t address;                // I2C address of the mux
+    uint8_t current;                // Enabled channels
+    bool known;                     // current matches the mux
+    uint32_t selects;               // Select transactions sent
+
+};
+
+class QN800x_MuxPort : public QN800x_Bus
+{
+
+public:
+
+    QN800x_MuxPort(QN800x_Mux &mux, uint8_t mask); // mask = 1 << channel, several bits for a broadcast port
+
+    uint8_t write(uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t len);
+    uint8_t read(uint8_t addr, uint8_t reg, uint8_t *data, uint8_t len);
+    bool recover();
+
+    void setMask(uint8_t mask);
+    uint8_t getMask();
+
+private:
+
+    QN800x_Mux &mux;                // Mux the port belongs to
+    uint8_t mask;                   // Channels of this port
+
+};
+
+
+#if defined(__linux__) && !defined(ARDUINO)
+
+class QN800x_LinuxBus : public QN800x_Bus
+{
+
+public:
+
+    QN800x_LinuxBus();
+    ~QN800x_LinuxBus();
+
+    bool open(const char *device);  // e.g. "/dev/i2c-1", returns false if the device can't be used
+    void close();
+
+    uint8_t write(uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t len);
+    uint8_t read(uint8_t addr, uint8_t reg, uint8_t *data, uint8_t len);
+
+private:
+
+    int fd;                     // File descriptor of the i2c-dev device, -1 if closed
+
+};
+
+#endif
+
+
+#endif
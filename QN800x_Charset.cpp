@@ -0,0 +1,125 @@
+/*
+QN8007 & QN8006 I2C FM Transmitter Library - UTF-8 to RDS character set
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+Author: Semir Nouri, December 2024
+
+*/
+
+#include <QN800x_Charset.h>
+
+/* Unicode code points above 0x7F that have an RDS code, sorted for the binary
+ * search, and their codes. Most come from the table of IEC 62106 Annex E, the
+ * rest are look-alikes for characters RDS does not have.
+ */
+
+static const uint16_t rdsCP[] PROGMEM = {
+    0x00A0, 0x00A1, 0x00A3, 0x00A4, 0x00A7, 0x00A9, 0x00AA, 0x00AB, 0x00AF, 0x00B0, 0x00B1, 0x00B2,
+    0x00B3, 0x00B4, 0x00B5, 0x00B9, 0x00BA, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00BF, 0x00C0, 0x00C1,
+    0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x00C7, 0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD,
+    0x00CE, 0x00CF, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D8, 0x00D9, 0x00DA, 0x00DB,
+    0x00DC, 0x00DD, 0x00DE, 0x00DF, 0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,
+    0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF, 0x00F0, 0x00F1, 0x00F2, 0x00F3,
+    0x00F4, 0x00F5, 0x00F6, 0x00F7, 0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x0106,
+    0x0107, 0x010C, 0x010D, 0x0110, 0x0111, 0x011B, 0x011E, 0x011F, 0x0130, 0x0131, 0x0132, 0x0133,
+    0x013F, 0x0140, 0x0144, 0x0148, 0x014A, 0x014B, 0x0151, 0x0152, 0x0153, 0x0154, 0x0155, 0x0158,
+    0x0159, 0x015A, 0x015B, 0x015E, 0x015F, 0x0160, 0x0161, 0x0166, 0x0167, 0x0171, 0x0175, 0x0177,
+    0x0179, 0x017A, 0x017D, 0x017E, 0x03B1, 0x03C0, 0x2013, 0x2014, 0x2015, 0x2016, 0x2018, 0x2019,
+    0x201C, 0x201D, 0x2026, 0x2030, 0x20AC, 0x2190, 0x2191, 0x2192, 0x2193
+};
+
+static const uint8_t rdsCode[] PROGMEM = {
+    0x20, 0x8E, 0xAA, 0x24, 0xBF, 0xA2, 0xA0, 0x22, 0x7E, 0xBB, 0xB4, 0xB2, 0xB3, 0x27, 0xB8, 0xB1,
+    0xB0, 0x22, 0xBC, 0xBD, 0xBE, 0xB9, 0xC1, 0xC0, 0xD0, 0xE0, 0xD1, 0xE1, 0xE2, 0x8B, 0xC3, 0xC2,
+    0xD2, 0xD3, 0xC5, 0xC4, 0xD4, 0xD5, 0x8A, 0xC7, 0xC6, 0xD6, 0xE6, 0xD7, 0xE7, 0xC9, 0xC8, 0xD8,
+    0xD9, 0xE5, 0xE8, 0x8D, 0x81, 0x80, 0x90, 0xF0, 0x91, 0xF1, 0xF2, 0x9B, 0x83, 0x82, 0x92, 0x93,
+    0x85, 0x84, 0x94, 0x95, 0xEF, 0x9A, 0x87, 0x86, 0x96, 0xF6, 0x97, 0xBA, 0xF7, 0x89, 0x88, 0x98,
+    0x99, 0xF5, 0xF8, 0xEB, 0xFB, 0xCB, 0xDB, 0xCE, 0xDE, 0xA5, 0xA4, 0x9D, 0xB5, 0x9E, 0x8F, 0x9F,
+    0xCF, 0xDF, 0xB6, 0xA6, 0xE9, 0xF9, 0xA7, 0xE3, 0xF3, 0xEA, 0xFA, 0xCA, 0xDA, 0xEC, 0xFC, 0x8C,
+    0x9C, 0xCC, 0xDC, 0xEE, 0xFE, 0xB7, 0xF4, 0xE4, 0xED, 0xFD, 0xCD, 0xDD, 0xA1, 0xA8, 0x2D, 0x2D,
+    0x5E, 0x60, 0x27, 0x27, 0x22, 0x22, 0x2E, 0xA3, 0xA9, 0xAC, 0xAD, 0xAE, 0xAF
+};
+
+#define RDS_CHARS (sizeof(rdsCode))
+
+QN800x_UTF8::QN800x_UTF8()
+{
+    reset();
+}
+
+void QN800x_UTF8::reset()
+{
+    cp = 0;
+    need = 0;
+    big = false;
+}
+
+int16_t QN800x_UTF8::put(uint8_t b)
+{
+    if ((b & 0xC0) == 0x80)                         // Continuation byte
+    {
+        if (need == 0) return RDS_SUBST;            // Without a lead byte, e.g. Latin-1 text
+        cp = (cp << 6) | (b & 0x3F);
+        if (--need) return -1;
+        return big ? RDS_SUBST : rdsChar(cp);
+    }
+
+    need = 0;                                       // A character that was cut short is dropped
+    big = false;
+
+    if (b < 0x80) return rdsChar(b);
+    if (b >= 0xC2 && b <= 0xDF) {cp = b & 0x1F; need = 1; return -1;}
+    if (b >= 0xE0 && b <= 0xEF) {cp = b & 0x0F; need = 2; return -1;}
+    if (b >= 0xF0 && b <= 0xF4) {cp = 0; need = 3; big = true; return -1;} // Emoji and the like
+    return RDS_SUBST;                               // 0xC0, 0xC1, 0xF5...0xFF are never valid
+}
+
+uint8_t QN800x_UTF8::rdsChar(uint16_t c) // RDS code of Unicode character c
+{
+    if (c < 0x80)                                   // G0 is ASCII with a few exceptions
+    {
+        if (c == '$') return 0xAB;                  // 0x24 is the currency sign
+        if (c == '`') return '\'';                  // 0x60 is a double bar
+        if (c == '^' || c == '~' || c == 0x7F) return RDS_SUBST;
+        return c;                                   // Control codes stay, CR ends the RT
+    }
+
+    uint8_t lo = 0;
+    uint8_t hi = RDS_CHARS;
+
+    while (lo < hi)
+    {
+        uint8_t mid = (lo + hi) / 2;
+        uint16_t m = pgm_read_word(&rdsCP[mid]);
+        if (m == c) return pgm_read_byte(&rdsCode[mid]);
+        if (m < c) lo = mid + 1; else hi = mid;
+    }
+    return RDS_SUBST;
+}
+
+uint16_t QN800x_UTF8::convert(char s[]) // UTF-8 string to RDS in place
+{
+    QN800x_UTF8 u;
+    uint16_t w = 0;
+
+    for (uint16_t r = 0; s[r] != '\0'; r++)
+    {
+        int16_t c = u.put((uint8_t) s[r]);
+        if (c >= 0) {s[w++] = (char) c;}            // Never ahead of the read position
+    }
+    s[w] = '\0';
+    return w;
+}
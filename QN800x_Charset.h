@@ -0,0 +1,61 @@
+/*
+QN8007 & QN8006 I2C FM Transmitter Library - UTF-8 to RDS character set
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+RDS receivers show PS and RT in the EBU Latin character set of IEC 62106 Annex E,
+not in UTF-8. QN800x_UTF8 decodes UTF-8 byte by byte and returns the RDS code of
+each character: ASCII stays as it is except '$' (0xAB), the accented letters,
+umlauts and symbols of the RDS table get their one byte code. Characters the
+RDS table does not have, invalid bytes and Latin-1 text become RDS_SUBST.
+Typographic quotes and dashes are sent as their ASCII look-alikes.
+
+The table lives in flash (PROGMEM) and is searched binary, a title of 64 letters
+takes well below a millisecond on an ATmega328. convert() works in place, the RDS text is
+never longer than the UTF-8 text.
+
+Author: Semir Nouri, December 2024
+
+*/
+
+#ifndef QN800x_Charset_h
+#define QN800x_Charset_h
+
+#include <QN800x_Port.h>
+
+#define RDS_SUBST '?'           /* Sent for characters without RDS code                */
+
+class QN800x_UTF8
+{
+
+public:
+
+    QN800x_UTF8();
+
+    int16_t put(uint8_t b);             // Next byte, RDS code when a character is complete, -1 inside a character
+    void reset();                       // Forget a character that was started
+
+    static uint8_t rdsChar(uint16_t cp);   // RDS code of Unicode character cp, RDS_SUBST if none
+    static uint16_t convert(char s[]);     // UTF-8 string to RDS in place, returns the new length
+
+private:
+
+    uint16_t cp;                        // Code point collected so far
+    uint8_t need;                       // Continuation bytes still expected
+    bool big;                           // Character outside the 16 bit range, no RDS code
+
+};
+
+#endif
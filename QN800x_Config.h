@@ -0,0 +1,62 @@
+/*
+QN8007 & QN8006 I2C FM Transmitter Library - Build options
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+The Arduino IDE compiles the library separately from the sketch, a #define in
+the sketch does not reach it. Set the options one of these ways:
+
+- Edit the defaults below. This changes them for every sketch using the library.
+- Compiler flags, every option is only defined here if it is not set already:
+    arduino-cli compile --build-property "build.extra_flags=-DQN800X_STATS=0" ...
+    PlatformIO, platformio.ini:  build_flags = -DQN800X_RDS=0 -DQN800X_I2S=0
+    CMake host build:            cmake -S . -B build -DCMAKE_CXX_FLAGS=-DQN800X_SHADOW=0
+
+Switched off parts are not compiled at all, so a small board keeps their RAM and
+flash for the application:
+
+QN800X_RDS 0   no PS, RT, carousel or group cache, tick() returns false at once.
+               QN800x_Meta and the RDS commands of QN800x_Task are left out.
+QN800X_I2S 0   initTransmit() always selects the analog input.
+QN800X_STATS 0 no getStats() counters.
+QN800X_SHADOW 0 the register shadow is not used as a cache: setters read the
+               register from the QN800x every time and no clean register is
+               rewritten to join bursts. For a QN800x that another master writes
+               as well. Writes are still collected by beginUpdate().
+
+Author: Semir Nouri, December 2024
+
+*/
+
+#ifndef QN800x_Config_h
+#define QN800x_Config_h
+
+#ifndef QN800X_STATS
+#define QN800X_STATS 1         /* 1 = bus and RDS counters with getStats(), 0 = left out, saves ~450 bytes RAM */
+#endif
+
+#ifndef QN800X_RDS
+#define QN800X_RDS 1           /* 1 = RDS engine, 0 = left out for "L" parts or no RDS, saves ~230 bytes RAM and half the flash */
+#endif
+
+#ifndef QN800X_I2S
+#define QN800X_I2S 1           /* 1 = I2S input and setDAsrate(), 0 = analog input only */
+#endif
+
+#ifndef QN800X_SHADOW
+#define QN800X_SHADOW 1        /* 1 = registers are read from the QN800x once, 0 = read again by every setter */
+#endif
+
+#endif
@@ -0,0 +1,195 @@
+/*
+QN8007 & QN8006 I2C FM Transmitter Library - Multi transmitter controller
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+Author: Semir Nouri, December 2024
+
+*/
+
+#include <QN800x_Fleet.h>
+
+QN800x_Fleet::QN800x_Fleet(QN800x_Mux &mux) : all(mux, 0)
+{
+    n = 0;
+    last = 0;
+    resetLoad();
+}
+
+bool QN800x_Fleet::add(QN800x_TX &t, uint8_t channel)
+{
+    if (n == FLEET_MAX || channel > 7) return false;
+
+    tx[n++] = &t;
+    all.setMask(all.getMask() | (1 << channel));
+    return true;
+}
+
+uint8_t QN800x_Fleet::size()
+{
+    return n;
+}
+
+QN800x_TX &QN800x_Fleet::operator[](uint8_t i)
+{
+    return *tx[i];
+}
+
+//-------------------Setup Section------------------------------
+
+bool QN800x_Fleet::begin(const QN800x_Setup &setup) // Cold start of all members
+{
+    bool ok = true;
+
+    for (uint8_t i = 0; i < n; i++)
+    {
+        uint32_t t0 = micros();
+        ok = tx[i]->begin(setup) && ok;
+        busyUs[i] += micros() - t0;
+    }
+
+    return ok;
+}
+
+bool QN800x_Fleet::broadcast(const QN800x_Setup &setup) // One write pass for all members
+{
+    /* Every member collects the setup in its own shadow copy. The first member
+     * then writes its changed registers through the broadcast port, which reaches
+     * all QN800x at once. The bursts also carry bridged clean registers of the
+     * first member, so every register that went out is compared: where a member
+     * holds another value it is marked dirty again and the member writes its own.
+     * A failed broadcast is not recovered through the broadcast port, that would
+     * restore the whole first member into every QN800x. The first member writes
+     * its rest on its own port instead, with the usual recovery.
+     */
+
+    if (n == 0) return true;
+
+    for (uint8_t i = 0; i < n; i++) {tx[i]->beginUpdate(); tx[i]->applySetup_(setup);}
+
+    QN800x_TX &lead = *tx[0];
+    QN800x_Bus *own = lead.bus;
+    uint8_t err = lead.busErr;
+    uint8_t fails = lead.busFails;
+    uint32_t sent = 0;
+
+    uint32_t t0 = micros();
+    lead.bus = &all;
+    lead.busRecov = true;                             // No recover_() through the broadcast port
+    lead.updDepth--;
+    bool ok = lead.flush_(&sent);
+    lead.busRecov = false;
+    lead.bus = own;
+    uint32_t done = sent & ~lead.shDirty;             // Failed bursts are dirty again
+
+    if (!ok)                                          // Not counted as a failure of the first member yet
+    {
+        lead.busErr = err;
+        lead.busFails = fails;
+        ok = lead.flush_();
+    }
+    busyUs[0] += micros() - t0;
+
+    for (uint8_t i = 1; i < n; i++)
+    {
+        QN800x_TX &m = *tx[i];
+
+        for (uint8_t j = 0; j < SH_LEN; j++)
+        {
+            if (!bitRead(sent, j)) continue;
+            if (!bitRead(m.shValid, j))               // Whatever it was, it is this now
+            {
+                if (bitRead(done, j)) {m.shadow[j] = lead.shadow[j]; bitSet(m.shValid, j);}
+                continue;
+            }
+            if (m.shadow[j] != lead.shadow[j]) {bitSet(m.shDirty, j); continue;}
+            if (bitRead(done, j)) bitClear(m.shDirty, j);  // Same value, arrived
+        }
+
+        t0 = micros();
+        ok = m.commitUpdate() && ok;                  // Writes nothing if the broadcast covered it all
+        busyUs[i] += micros() - t0;
+    }
+
+    return ok;
+}
+
+//-------------------RDS Section--------------------------------
+
+#if QN800X_RDS
+void QN800x_Fleet::startCarousel() // Start all carousels with evenly spread group slots
+{
+    for (uint8_t i = 0; i < n; i++)
+    {
+        tx[i]->startCarousel();
+        tx[i]->shiftRDS_((uint32_t) i * (RDS_GROUP_US / n)); // Follows the QN800x itself in RDS_PACE_CHIP
+    }
+}
+#endif
+
+bool QN800x_Fleet::tick() // Earliest due member first
+{
+    uint8_t best = 0xFF;
+    uint32_t bestW = 0xFFFFFFFFUL;
+
+    for (uint8_t k = 1; k <= n; k++)                 // Start after the member served last
+    {
+        uint8_t i = (last + k) % n;
+        uint32_t w = tx[i]->rdsWait_();
+        if (w < bestW) {bestW = w; best = i;}
+    }
+
+    if (best == 0xFF || bestW > 0) return false;     // Nobody due, the bus stays free
+
+    uint32_t t0 = micros();
+    bool sent = tx[best]->tick();
+    busyUs[best] += micros() - t0;
+    last = best;
+
+    return sent;
+}
+
+uint32_t QN800x_Fleet::nextTick() // Earliest slot of all members
+{
+    uint32_t w = 0xFFFFFFFFUL;
+    for (uint8_t i = 0; i < n; i++)
+    {
+        uint32_t t = tx[i]->rdsWait_();
+        if (t < w) w = t;
+    }
+    return w;
+}
+
+//-------------------Bus Load Section---------------------------
+
+uint16_t QN800x_Fleet::getLoad(uint8_t i)
+{
+    uint32_t span = micros() - loadT;
+    if (i >= n || span == 0) return 0;
+    return (uint64_t) busyUs[i] * 1000 / span;
+}
+
+uint16_t QN800x_Fleet::getBusLoad()
+{
+    uint16_t sum = 0;
+    for (uint8_t i = 0; i < n; i++) {sum += getLoad(i);}
+    return sum;
+}
+
+void QN800x_Fleet::resetLoad()
+{
+    for (uint8_t i = 0; i < FLEET_MAX; i++) {busyUs[i] = 0;}
+    loadT = micros();
+}
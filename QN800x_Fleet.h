@@ -0,0 +1,74 @@
+/*
+QN8007 & QN8006 I2C FM Transmitter Library - Multi transmitter controller
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+QN800x_Fleet drives up to FLEET_MAX QN800x_TX behind one I2C multiplexer, e.g.
+several transmitters sharing one XCLK (setExtClk). Each QN800x_TX keeps its own
+state and talks through its own QN800x_MuxPort. The fleet
+
+- spreads the RDS group slots of its members evenly over one group period, so
+  the loads of two transmitters never compete for the bus,
+- calls tick() only for the member whose slot is due first, round robin on ties,
+- writes an identical setup to all members in one pass through a broadcast port,
+- measures the bus time spent for each member.
+
+Author: Semir Nouri, December 2024
+
+*/
+
+#ifndef QN800x_Fleet_h
+#define QN800x_Fleet_h
+
+#include <QN800x_TX.h>
+
+#define FLEET_MAX 8             /* Members, one per mux channel                       */
+
+class QN800x_Fleet
+{
+
+public:
+
+    QN800x_Fleet(QN800x_Mux &mux);
+
+    bool add(QN800x_TX &tx, uint8_t channel); // Member on mux channel 0...7, false if full
+    uint8_t size();                           // Number of members
+    QN800x_TX &operator[](uint8_t i);         // Member i in the order added
+
+    bool begin(const QN800x_Setup &setup);    // begin() of all members, true if all answered
+    bool broadcast(const QN800x_Setup &setup);// Same setup to all members, written once for all
+
+#if QN800X_RDS
+    void startCarousel();             // Carousel of all members, group slots staggered by RDS_GROUP_US / size()
+#endif
+    bool tick();                      // Call from loop(), serves the member whose group slot is due first
+    uint32_t nextTick();              // Time in µs until tick() has work for any member, 0xFFFFFFFF = all idle
+
+    uint16_t getLoad(uint8_t i);      // Bus load caused by member i in 1/1000 since resetLoad()
+    uint16_t getBusLoad();            // Bus load of all members in 1/1000
+    void resetLoad();
+
+private:
+
+    QN800x_TX *tx[FLEET_MAX];         // Members
+    uint8_t n;                        // Number of members
+    uint8_t last;                     // Member served last, for round robin on ties
+    QN800x_MuxPort all;               // Broadcast port, all member channels enabled
+    uint32_t busyUs[FLEET_MAX];       // Bus time per member since resetLoad()
+    uint32_t loadT;                   // micros() time stamp of resetLoad()
+
+};
+
+#endif
@@ -0,0 +1,164 @@
+/*
+QN8007 & QN8006 I2C FM Transmitter Library - Metadata ingester
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+Author: Semir Nouri, December 2024
+
+*/
+
+#include <QN800x_Meta.h>
+
+#if QN800X_RDS
+
+QN800x_Meta::QN800x_Meta()
+{
+    len = 0;
+    over = false;
+    useUTF8 = true;
+    out[0] = '\0';
+    parts[0] = '\0';
+    art = parts;
+    tit = out;
+    preN = 0;
+    sep = " - ";
+    hit = -1;
+    ab = false;
+    overflows = 0;
+}
+
+bool QN800x_Meta::addPrefix(const char *prefix)
+{
+    if (preN == META_PREFIXES) return false;
+
+    pre[preN++] = prefix;
+    return true;
+}
+
+void QN800x_Meta::setSeparator(const char *s)
+{
+    sep = s;
+}
+
+void QN800x_Meta::setUTF8(bool on)
+{
+    useUTF8 = on;
+    utf8.reset();
+}
+
+bool QN800x_Meta::feed(char c)
+{
+    if (useUTF8)
+    {
+        int16_t r = utf8.put((uint8_t) c);
+        if (r < 0) return false;      // Inside a multi byte character
+        c = (char) r;
+    }
+
+    if (c == '\r' || c == '\n')         // End of line, CR LF gives an empty second line
+    {
+        if (len == 0 && !over) return false;
+
+        if (over) {overflows++;}
+        line_();
+        len = 0;
+        over = false;
+        return true;
+    }
+
+    if (len < META_LEN) {line[len++] = c;}
+    else over = true;                 // The RT could not show it anyway
+    return false;
+}
+
+#ifdef ARDUINO
+bool QN800x_Meta::poll(Stream &s)
+{
+    while (s.available() > 0)         // Only what is already there, returns at once
+    {
+        if (feed((char) s.read())) return true;   // The rest stays in the serial buffer for the next call
+    }
+    return false;
+}
+#endif
+
+void QN800x_Meta::line_() // Strip, cut and split a complete line
+{
+    uint8_t p = 0;
+    hit = -1;
+
+    for (uint8_t i = 0; i < preN && hit < 0; i++)
+    {
+        uint8_t n = strlen(pre[i]);
+        if (n <= len && memcmp(line, pre[i], n) == 0) {hit = i; p = n;}
+    }
+
+    while (p < len && (line[p] == ':' || line[p] == ' ')) {p++;}   // "##CLI.META#: Artist - Title"
+
+    uint8_t e = len;
+    while (e > p && line[e-1] == ' ') {e--;}                      // Trailing blanks
+    if (e - p > META_RT) {e = p + META_RT;}
+
+    memcpy(out, line + p, e - p);
+    out[e - p] = '\0';
+
+    art = "";                         // No separator: the whole text is the title
+    tit = out;
+    const char *s = (sep[0] != '\0') ? strstr(out, sep) : NULL;
+    if (s)
+    {
+        uint8_t a = s - out;
+        memcpy(parts, out, e - p + 1);
+        parts[a] = '\0';
+        art = parts;
+        tit = parts + a + strlen(sep);
+    }
+}
+
+const char *QN800x_Meta::text()
+{
+    return out;
+}
+
+const char *QN800x_Meta::artist()
+{
+    return art;
+}
+
+const char *QN800x_Meta::title()
+{
+    return tit;
+}
+
+int8_t QN800x_Meta::prefix()
+{
+    return hit;
+}
+
+void QN800x_Meta::apply(QN800x_TX &tx, uint16_t pty)
+{
+    ab = !ab;                         // New title, receivers clear their RT display
+    tx.loadRDS_RT(out, pty, ab);
+    tx.rushRT();                      // First segment in the next carousel slot
+}
+
+uint16_t QN800x_Meta::getOverflows(bool reset)
+{
+    uint16_t n = overflows;
+    if (reset) {overflows = 0;}
+    return n;
+}
+
+#endif
@@ -0,0 +1,94 @@
+/*
+QN8007 & QN8006 I2C FM Transmitter Library - Metadata ingester
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+QN800x_Meta turns a byte stream from a web radio or playout host into RT text.
+Bytes go into a fixed line buffer one at a time as they arrive, nothing waits for
+a timeout and no String or heap is used. A complete line
+
+- is converted from UTF-8 to the RDS character set while it arrives,
+- loses a configured prefix like "##CLI.META#" and the ": " behind it,
+- is cut to the 64 characters of an RT,
+- is split into artist and title at " - ",
+
+and apply() puts it into the RT group cache of a QN800x_TX with a new A/B flag.
+In carousel mode its first segment goes out in the next group slot.
+
+Author: Semir Nouri, December 2024
+
+*/
+
+#ifndef QN800x_Meta_h
+#define QN800x_Meta_h
+
+#include <QN800x_TX.h>
+#include <QN800x_Charset.h>
+
+#if QN800X_RDS
+
+#define META_LEN 80             /* Line buffer, prefix + 64 characters of text         */
+#define META_RT 64              /* Longest RT (2A)                                     */
+#define META_PREFIXES 4         /* Prefixes that can be recognised                     */
+
+class QN800x_Meta
+{
+
+public:
+
+    QN800x_Meta();
+
+    bool addPrefix(const char *prefix);   // Metadata lines start with prefix, the string must stay valid, false if full
+    void setSeparator(const char *sep);   // Between artist and title, default " - "
+    void setUTF8(bool on);                // Convert UTF-8 to RDS characters (default), off for text already in RDS
+
+    bool feed(char c);                    // Next byte of the stream, true when a line is complete
+#ifdef ARDUINO
+    bool poll(Stream &s);                 // feed() what s has received, true when a line is complete
+#endif
+
+    const char *text();                   // Text of the last line without prefix, at most 64 characters
+    const char *artist();                 // Part before the separator, "" without separator
+    const char *title();                  // Part after the separator, the whole text without separator
+    int8_t prefix();                      // Index of the prefix the line started with, -1 = none
+
+    void apply(QN800x_TX &tx, uint16_t pty); // Put text() on air as a new RT
+    uint16_t getOverflows(bool reset);    // Lines longer than META_LEN, the rest was dropped
+
+private:
+
+    char line[META_LEN];              // Line being received
+    uint8_t len;                      // Bytes in line
+    bool over;                        // Line longer than the buffer
+    QN800x_UTF8 utf8;                 // Decoder for the byte stream
+    bool useUTF8;
+    char out[META_RT + 1];            // Text of the last complete line
+    char parts[META_RT + 1];          // Copy of out split into artist and title
+    const char *art;                  // Artist in parts
+    const char *tit;                  // Title in parts or out
+    const char *pre[META_PREFIXES];   // Recognised prefixes
+    uint8_t preN;                     // Number of prefixes
+    const char *sep;                  // Separator between artist and title
+    int8_t hit;                       // Prefix of the last line
+    bool ab;                          // A/B flag of the RT on air
+    uint16_t overflows;
+
+    void line_();                     // Strip, cut and split a complete line
+
+};
+
+#endif
+
+#endif
@@ -0,0 +1,100 @@
+/*
+QN8007 & QN8006 I2C FM Transmitter Library - Platform layer
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+Author: Semir Nouri, December 2024
+
+*/
+
+#ifndef ARDUINO
+
+#include <QN800x_Port.h>
+#include <time.h>
+
+static uint64_t monoMicros64_() // Monotonic host clock in µs, never wraps
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+static uint32_t monoMicros_()
+{
+    return (uint32_t) monoMicros64_();
+}
+
+static void monoWait_(uint32_t us) // Sleep on the host clock
+{
+    struct timespec ts;
+    ts.tv_sec = us / 1000000UL;
+    ts.tv_nsec = (us % 1000000UL) * 1000;
+    nanosleep(&ts, NULL);
+}
+
+static uint32_t (*clockNow)() = monoMicros_;   // Current host clock
+static void (*clockWait)(uint32_t) = monoWait_;
+static uint32_t clockStart = monoMicros_();    // micros() starts at 0 like on Arduino
+static uint64_t clockStart64 = monoMicros64_(); // Same for millis()
+static uint32_t clockLast = 0;                 // Last value of a replaced clock
+static uint64_t clockExt = 0;                  // Replaced clock extended to 64 bits
+
+/* millis() must wrap after 2^32 ms like on Arduino, not when the 32 bit µs
+ * counter wraps after 71.6 minutes, or every millis() - t0 across that point
+ * becomes huge. The host clock is read with 64 bits, a replaced 32 bit clock
+ * is extended on every call.
+ */
+
+static uint64_t clockNow64_()
+{
+    if (clockNow == monoMicros_) return monoMicros64_();
+
+    uint32_t now = clockNow();
+    clockExt += (uint32_t) (now - clockLast);
+    clockLast = now;
+    return clockExt;
+}
+
+uint32_t micros()
+{
+    return clockNow() - clockStart;
+}
+
+uint32_t millis()
+{
+    return (uint32_t) ((clockNow64_() - clockStart64) / 1000);
+}
+
+void delay(uint32_t ms)
+{
+    clockWait(ms * 1000UL);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    clockWait(us);
+}
+
+void setHostClock(uint32_t (*now_us)(), void (*wait_us)(uint32_t))
+{
+    clockNow = now_us ? now_us : monoMicros_;
+    clockWait = wait_us ? wait_us : monoWait_;
+    clockStart = clockNow();
+    clockLast = clockStart;
+    clockExt = 0;
+    clockStart64 = clockNow64_();
+}
+
+#endif
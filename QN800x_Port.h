@@ -0,0 +1,56 @@
+/*
+QN8007 & QN8006 I2C FM Transmitter Library - Platform layer
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+On Arduino this is just <Arduino.h>. On a desktop host it supplies the few
+Arduino functions the library uses: millis(), micros(), delay(), the bit
+macros and PROGMEM. The host clock can be replaced, e.g. by the virtual time of
+the simulated QN800x, so a test run does not have to wait in real time.
+
+Author: Semir Nouri, December 2024
+
+*/
+
+#ifndef QN800x_Port_h
+#define QN800x_Port_h
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+
+#else
+
+#include <stdint.h>
+#include <string.h>
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+
+#define PROGMEM                      // Tables in flash are ordinary constants on a host
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+
+uint32_t millis();                   // Milliseconds since start of the host clock
+uint32_t micros();                   // Microseconds since start of the host clock
+void delay(uint32_t ms);             // Wait ms milliseconds
+void delayMicroseconds(uint32_t us); // Wait us microseconds
+
+void setHostClock(uint32_t (*now_us)(), void (*wait_us)(uint32_t)); // Replace the host clock, NULL restores it
+
+#endif
+
+#endif
@@ -0,0 +1,254 @@
+/*
+QN8007 & QN8006 I2C FM Transmitter Library - RDS baseband codec
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+Author: Semir Nouri, December 2024
+
+*/
+
+#include <QN800x_RDScodec.h>
+
+/* Checkword of a byte b followed by 10 zero bits: b(x) * x^10 mod g(x). Two look
+ * ups per block, see check().
+ */
+
+static const uint16_t crcTab[256] PROGMEM = {
+    0x000, 0x1B9, 0x372, 0x2CB, 0x35D, 0x2E4, 0x02F, 0x196, 0x303, 0x2BA, 0x071, 0x1C8,
+    0x05E, 0x1E7, 0x32C, 0x295, 0x3BF, 0x206, 0x0CD, 0x174, 0x0E2, 0x15B, 0x390, 0x229,
+    0x0BC, 0x105, 0x3CE, 0x277, 0x3E1, 0x258, 0x093, 0x12A, 0x2C7, 0x37E, 0x1B5, 0x00C,
+    0x19A, 0x023, 0x2E8, 0x351, 0x1C4, 0x07D, 0x2B6, 0x30F, 0x299, 0x320, 0x1EB, 0x052,
+    0x178, 0x0C1, 0x20A, 0x3B3, 0x225, 0x39C, 0x157, 0x0EE, 0x27B, 0x3C2, 0x109, 0x0B0,
+    0x126, 0x09F, 0x254, 0x3ED, 0x037, 0x18E, 0x345, 0x2FC, 0x36A, 0x2D3, 0x018, 0x1A1,
+    0x334, 0x28D, 0x046, 0x1FF, 0x069, 0x1D0, 0x31B, 0x2A2, 0x388, 0x231, 0x0FA, 0x143,
+    0x0D5, 0x16C, 0x3A7, 0x21E, 0x08B, 0x132, 0x3F9, 0x240, 0x3D6, 0x26F, 0x0A4, 0x11D,
+    0x2F0, 0x349, 0x182, 0x03B, 0x1AD, 0x014, 0x2DF, 0x366, 0x1F3, 0x04A, 0x281, 0x338,
+    0x2AE, 0x317, 0x1DC, 0x065, 0x14F, 0x0F6, 0x23D, 0x384, 0x212, 0x3AB, 0x160, 0x0D9,
+    0x24C, 0x3F5, 0x13E, 0x087, 0x111, 0x0A8, 0x263, 0x3DA, 0x06E, 0x1D7, 0x31C, 0x2A5,
+    0x333, 0x28A, 0x041, 0x1F8, 0x36D, 0x2D4, 0x01F, 0x1A6, 0x030, 0x189, 0x342, 0x2FB,
+    0x3D1, 0x268, 0x0A3, 0x11A, 0x08C, 0x135, 0x3FE, 0x247, 0x0D2, 0x16B, 0x3A0, 0x219,
+    0x38F, 0x236, 0x0FD, 0x144, 0x2A9, 0x310, 0x1DB, 0x062, 0x1F4, 0x04D, 0x286, 0x33F,
+    0x1AA, 0x013, 0x2D8, 0x361, 0x2F7, 0x34E, 0x185, 0x03C, 0x116, 0x0AF, 0x264, 0x3DD,
+    0x24B, 0x3F2, 0x139, 0x080, 0x215, 0x3AC, 0x167, 0x0DE, 0x148, 0x0F1, 0x23A, 0x383,
+    0x059, 0x1E0, 0x32B, 0x292, 0x304, 0x2BD, 0x076, 0x1CF, 0x35A, 0x2E3, 0x028, 0x191,
+    0x007, 0x1BE, 0x375, 0x2CC, 0x3E6, 0x25F, 0x094, 0x12D, 0x0BB, 0x102, 0x3C9, 0x270,
+    0x0E5, 0x15C, 0x397, 0x22E, 0x3B8, 0x201, 0x0CA, 0x173, 0x29E, 0x327, 0x1EC, 0x055,
+    0x1C3, 0x07A, 0x2B1, 0x308, 0x19D, 0x024, 0x2EF, 0x356, 0x2C0, 0x379, 0x1B2, 0x00B,
+    0x121, 0x098, 0x253, 0x3EA, 0x27C, 0x3C5, 0x10E, 0x0B7, 0x222, 0x39B, 0x150, 0x0E9,
+    0x17F, 0x0C6, 0x20D, 0x3B4
+};
+
+/* Rows of the parity check matrix H of IEC 62106 Annex B for the 10 check bits.
+ * A valid codeword has syndrome 0, so the syndrome of a received block is the
+ * one of its checkword error: check(data) XOR received check bits.
+ */
+
+static const uint16_t synRows[10] PROGMEM = {0x355, 0x376, 0x1BB, 0x201, 0x3DC, 0x1EE, 0x0F7, 0x2A7, 0x38F, 0x31B};
+
+static const uint16_t offsets[5] = {RDS_OFS_A, RDS_OFS_B, RDS_OFS_C, RDS_OFS_D, RDS_OFS_CX};
+
+//-------------------Encoder Section----------------------------
+
+QN800x_RDSenc::QN800x_RDSenc()
+{
+    reset();
+}
+
+void QN800x_RDSenc::reset()
+{
+    last = 0;
+}
+
+uint16_t QN800x_RDSenc::check(uint16_t data) // 10 bit checkword
+{
+    uint16_t a = pgm_read_word(&crcTab[data >> 8]);                           // High byte
+    return pgm_read_word(&crcTab[(a >> 2) ^ (data & 0xFF)]) ^ ((a & 3) << 8); // Its remainder moves 8 bits up with the low byte
+}
+
+uint32_t QN800x_RDSenc::block(uint16_t data, uint16_t offset)
+{
+    return ((uint32_t) data << 10) | (check(data) ^ offset);
+}
+
+void QN800x_RDSenc::encode(const uint8_t group[8], uint8_t out[RDS_GROUP_BYTES])
+{
+    bool verB = bitRead(group[2], 3);                   // Block B bit 11: version B, block C gets C'
+    uint8_t n = 0;                                      // Bits written
+
+    memset(out, 0, RDS_GROUP_BYTES);
+
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        uint16_t data = ((uint16_t) group[2*i] << 8) | group[2*i+1];
+        uint32_t b = block(data, offsets[(i == 2 && verB) ? 4 : i]);
+
+        for (int8_t k = 25; k >= 0; k--, n++)
+        {
+            last = last ^ ((b >> k) & 1);               // Differential: a 1 changes the channel bit
+            if (last) out[n >> 3] |= 0x80 >> (n & 7);
+        }
+    }
+}
+
+//-------------------Decoder Section----------------------------
+
+QN800x_RDSdec::QN800x_RDSdec()
+{
+    prev = 0;
+    groups = 0;
+    badBlocks = 0;
+    syncs = 0;
+    memset(out, 0, sizeof(out));
+    reset();
+}
+
+void QN800x_RDSdec::reset()
+{
+    reg = 0;
+    bits = 0;
+    blk = 0;
+    bad = 0;
+    sync = false;
+    cand = -1;
+    since = 0;
+    good = 0;
+}
+
+uint16_t QN800x_RDSdec::syndrome(uint32_t b)
+{
+    uint16_t e = QN800x_RDSenc::check((uint16_t) (b >> 10)) ^ (b & 0x3FF); // Checkword error
+    uint16_t s = 0;
+
+    for (uint8_t k = 0; k < 10; k++)
+    {
+        if (bitRead(e, 9 - k)) s ^= pgm_read_word(&synRows[k]);
+    }
+    return s;
+}
+
+int8_t QN800x_RDSdec::which_(uint16_t syn)
+{
+    switch (syn)
+    {
+    case RDS_SYN_A: return 0;
+    case RDS_SYN_B: return 1;
+    case RDS_SYN_C:
+    case RDS_SYN_CX: return 2;
+    case RDS_SYN_D: return 3;
+    }
+    return -1;
+}
+
+bool QN800x_RDSdec::put(uint8_t bit)
+{
+    bit = bit ? 1 : 0;
+    reg = ((reg << 1) | (bit ^ prev)) & 0x3FFFFFFUL;   // Differential decoding
+    prev = bit;
+
+    if (bits < 26) bits++;
+
+    if (bits < 26) return false;                       // Block not complete
+
+    if (sync) return block_();
+
+    /* Searching: a block with a valid syndrome is a candidate, exactly 26 bits
+     * later the next block of the group must follow. Random data matches one of
+     * the syndromes about once in 200 bits, two in a row rarely.
+     */
+
+    int8_t b = which_(syndrome(reg));
+
+    if (cand >= 0 && ++since == 26)
+    {
+        if (b == (cand + 1) % 4)
+        {
+            sync = true;
+            syncs++;
+            blk = b;
+            good = 0;
+            return block_();
+        }
+        cand = -1;                                     // Not followed by a block, forget it
+    }
+
+    if (cand < 0 && b >= 0) {cand = b; since = 0;}
+    return false;
+}
+
+bool QN800x_RDSdec::block_() // reg holds block blk
+{
+    int8_t b = which_(syndrome(reg));
+
+    bits = 0;
+    if (blk == 0) {good = 0;}                          // A new group starts with block A
+
+    if (b == blk)
+    {
+        bad = 0;
+        grp[2*blk] = reg >> 18;
+        grp[2*blk+1] = (reg >> 10) & 0xFF;
+        bitSet(good, blk);
+    }
+    else
+    {
+        badBlocks++;
+        if (++bad == RDS_SYNC_LOSS) {reset(); bits = 26; return false;} // Lost the block boundaries, reg stays full
+    }
+
+    blk = (blk + 1) & 3;
+
+    if (blk != 0 || good != 0x0F) return false;        // Group incomplete or with a bad block
+
+    memcpy(out, grp, 8);
+    groups++;
+    good = 0;
+    return true;
+}
+
+bool QN800x_RDSdec::putByte(uint8_t b)
+{
+    bool done = false;
+
+    for (int8_t k = 7; k >= 0; k--)
+    {
+        if (put((b >> k) & 1)) done = true;            // At most one group ends in 8 bits
+    }
+    return done;
+}
+
+const uint8_t *QN800x_RDSdec::group()
+{
+    return out;
+}
+
+bool QN800x_RDSdec::synced()
+{
+    return sync;
+}
+
+uint32_t QN800x_RDSdec::getGroups()
+{
+    return groups;
+}
+
+uint32_t QN800x_RDSdec::getBadBlocks()
+{
+    return badBlocks;
+}
+
+uint32_t QN800x_RDSdec::getSyncs()
+{
+    return syncs;
+}
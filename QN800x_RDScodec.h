@@ -0,0 +1,114 @@
+/*
+QN8007 & QN8006 I2C FM Transmitter Library - RDS baseband codec
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+The QN800x turns the 8 bytes in RDS0...RDS7 into the RDS bit stream itself. To
+check what goes on air without a receiver, QN800x_RDSenc does the same on the
+host: each 16 bit block gets its 10 bit checkword plus offset word A, B, C (C'
+in version B groups) or D, and the 104 bits of a group are differentially
+encoded as for the 1187.5 bit/s data channel. QN800x_RDSdec takes such a stream
+bit by bit, finds the block boundaries from the syndromes of IEC 62106 Annex B
+and returns the group bytes again. The biphase symbols and the 57 kHz carrier
+are left to the QN800x.
+
+Together with QN800x_SimBus.onGroup every group a sketch sends can be encoded,
+decoded and compared, e.g. PS and RT segment addresses, the A/B flag and the PI
+code. The checkwords come from a 256 entry table, one group takes a few µs.
+
+Author: Semir Nouri, December 2024
+
+*/
+
+#ifndef QN800x_RDScodec_h
+#define QN800x_RDScodec_h
+
+#include <QN800x_Port.h>
+
+#define RDS_POLY   0x5B9       /* Generator x^10 + x^8 + x^7 + x^5 + x^4 + x^3 + 1    */
+#define RDS_OFS_A  0x0FC       /* Offset words added to the checkwords                */
+#define RDS_OFS_B  0x198
+#define RDS_OFS_C  0x168
+#define RDS_OFS_CX 0x350       /* C' of version B groups                              */
+#define RDS_OFS_D  0x1B4
+#define RDS_SYN_A  0x3D8       /* Syndromes of error free blocks, IEC 62106 Table B.1 */
+#define RDS_SYN_B  0x3D4
+#define RDS_SYN_C  0x25C
+#define RDS_SYN_CX 0x3CC
+#define RDS_SYN_D  0x258
+#define RDS_GROUP_BYTES 13     /* 104 bits of one group                               */
+#define RDS_SYNC_LOSS 5        /* Bad blocks in a row until the decoder searches again */
+
+class QN800x_RDSenc
+{
+
+public:
+
+    QN800x_RDSenc();
+
+    void encode(const uint8_t group[8], uint8_t out[RDS_GROUP_BYTES]); // RDS0...RDS7 to 104 bits, first bit in the MSB of out[0]
+    void reset();                               // Differential encoder starts from 0
+
+    static uint16_t check(uint16_t data);       // 10 bit checkword of a block, without offset
+    static uint32_t block(uint16_t data, uint16_t offset); // 26 bit block with checkword and offset word
+
+private:
+
+    uint8_t last;                     // Last bit sent, for the differential encoding
+
+};
+
+class QN800x_RDSdec
+{
+
+public:
+
+    QN800x_RDSdec();
+
+    bool put(uint8_t bit);            // Next bit of the stream, true when a group is complete
+    bool putByte(uint8_t b);          // 8 bits, MSB first, true when a group is complete
+    const uint8_t *group();           // RDS0...RDS7 of the last complete group
+    bool synced();                    // Block boundaries known
+    void reset();                     // Search for the block boundaries again
+
+    uint32_t getGroups();             // Groups decoded
+    uint32_t getBadBlocks();          // Blocks with a wrong syndrome while synced
+    uint32_t getSyncs();              // Times the decoder found the block boundaries
+
+    static uint16_t syndrome(uint32_t block); // Syndrome of a 26 bit block, RDS_SYN_A...RDS_SYN_D if it is error free
+
+private:
+
+    uint32_t reg;                     // Last 26 bits received
+    uint8_t prev;                     // Last channel bit, for the differential decoding
+    uint8_t bits;                     // Bits in reg, or since the last block boundary once synced
+    uint8_t blk;                      // Block expected next, 0...3 = A...D
+    uint8_t bad;                      // Bad blocks in a row
+    bool sync;
+    int8_t cand;                      // Block found while searching, -1 = none
+    uint8_t since;                    // Bits since that block
+    uint8_t grp[8];                   // Group being collected
+    uint8_t out[8];                   // Last complete group
+    uint8_t good;                     // Blocks of grp received without error, bit mask
+    uint32_t groups;
+    uint32_t badBlocks;
+    uint32_t syncs;
+
+    int8_t which_(uint16_t syn);      // Block 0...3 of a syndrome, C' counts as 2, -1 = none
+    bool block_();                    // Store the block in reg, true when a group is complete
+
+};
+
+#endif
@@ -0,0 +1,343 @@
+/*
+QN8007 & QN8006 I2C FM Transmitter Library - Simulated QN800x
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+Author: Semir Nouri, December 2024
+
+*/
+
+#include <QN800x_Sim.h>
+#include <QN800x_TX.h>
+
+//-------------------Virtual Time Section-----------------------
+
+#ifndef ARDUINO
+
+static uint32_t simTime = 0;            // Simulated µs
+
+static uint32_t simNow_()               // Each look at the clock costs a little CPU time
+{
+    simTime += SIM_POLL_US;
+    return simTime;
+}
+
+static void simWait_(uint32_t us)
+{
+    simTime += us;
+}
+
+void QN800x_SimBus::useVirtualTime(bool on)
+{
+    if (on) setHostClock(simNow_, simWait_);
+    if (!on) setHostClock(NULL, NULL);
+}
+
+static void simBusy_(uint32_t us)       // Time the host spends in a bus transfer
+{
+    simTime += us;
+}
+
+#else
+
+static void simBusy_(uint32_t us)       // Real time on Arduino, bus time is only counted
+{
+    (void) us;
+}
+
+#endif
+
+static uint32_t xferUs_(uint8_t len, bool rd, uint32_t hz) // Bus time of one transaction
+{
+    if (hz == 0) return 0;
+
+    // 9 clocks per byte, plus start, repeated start and stop
+    uint32_t bits = rd ? (len + 3) * 9 + 3 : (len + 2) * 9 + 2;
+    return (bits * 1000000UL + hz - 1) / hz;
+}
+
+//-------------------Device Model Section-----------------------
+
+QN800x_SimBus::QN800x_SimBus(uint8_t addr)
+{
+    address = addr;
+    clockHz = 400000;                   // Fast mode as used by the examples
+    onGroup = NULL;
+    onTransfer = NULL;
+    busUs = 0;
+    faultN = 0;
+    faultStatus = 0;
+    hung = false;
+    recoveries = 0;
+    cid = CID_QN800X << 2;
+    inReset = false;
+    clearLog();
+    powerUp();
+}
+
+void QN800x_SimBus::powerUp()
+{
+    memset(regs, 0, sizeof(regs));
+
+    regs[ANACTL1] = 0b00101011;         // Base band out of reset, 26 MHz crystal
+    regs[RDSFDEV] = 0b10000110;         // RDS deviation 6
+    regs[REG_XLT3] = 0b00000100;        // Crystal oscillator
+    regs[CID1] = 0b00000001;            // FM family, minor revision 1
+    regs[CID2] = cid;
+
+    pendingValid = false;
+    rdsOn = false;
+    groupsSent = 0;
+    groupsRepeated = 0;
+    groupsLost = 0;
+}
+
+void QN800x_SimBus::setChipID(uint8_t cid2)
+{
+    cid = cid2;
+    regs[CID2] = cid2;
+}
+
+void QN800x_SimBus::setBusClock(uint32_t hz)
+{
+    clockHz = hz;
+}
+
+uint8_t QN800x_SimBus::peek(uint8_t reg)
+{
+    advance_();
+    return reg < SIM_REGS ? regs[reg] : 0;
+}
+
+uint32_t QN800x_SimBus::busTime()
+{
+    return busUs;
+}
+
+void QN800x_SimBus::advance_() // Group boundaries up to now
+{
+    uint32_t now = micros();
+
+    while (rdsOn && (int32_t) (now - nextGroupT) >= 0)
+    {
+        if (pendingValid)                                   // Fetch the group and confirm with RDS_TXUPD
+        {
+            pendingValid = false;
+            regs[STATUS3] = regs[STATUS3] ^ (1 << RDS_TXUPD);
+            groupsSent++;
+            if (onGroup) onGroup(pending, nextGroupT);
+        }
+        else groupsRepeated++;                              // Nothing new, the chip sends the last group again
+
+        nextGroupT += RDS_GROUP_US;
+    }
+}
+
+void QN800x_SimBus::store_(uint8_t reg, uint8_t val) // Register write with the side effects of the real chip
+{
+    if (reg >= SIM_REGS) return;
+
+    uint8_t old = regs[reg];
+    regs[reg] = val;
+
+    if (reg == SYSTEM1 && bitRead(val, 7))                        // Software reset, bit clears itself
+    {
+        powerUp();
+        resetT = micros();
+        inReset = true;
+        return;
+    }
+
+    if (reg == SYSTEM1 && bitRead(old ^ val, 2))                  // RDS ready toggled, hand over RDS0...RDS7
+    {
+        if (pendingValid) groupsLost++;                           // Previous group was never fetched
+        memcpy(pending, regs + RDS0, 8);
+        pendingValid = true;
+    }
+
+    bool on = bitRead(regs[SYSTEM0], 6) && bitRead(regs[SYSTEM0], 1); // Transmitting with RDS enabled
+
+    if (on && !rdsOn) nextGroupT = micros() + RDS_GROUP_US;        // Group clock starts
+    rdsOn = on;
+}
+
+void QN800x_SimBus::transfer_(uint8_t addr, uint8_t reg, uint8_t len, bool rd, uint8_t status)
+{
+    uint32_t us = xferUs_(len, rd, clockHz);
+    busUs += us;
+    simBusy_(us);
+
+    QN800x_SimEvent &e = log[logHead];
+    e.t = micros();
+    e.addr = addr;
+    e.reg = reg;
+    e.len = len;
+    e.read = rd;
+    e.status = status;
+
+    logHead = (logHead + 1) % SIM_LOG_LEN;
+    if (logN < SIM_LOG_LEN) logN++;
+
+    if (onTransfer) onTransfer(e);
+}
+
+uint8_t QN800x_SimBus::write(uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t len)
+{
+    if (addr != address) {transfer_(addr, reg, 0, false, 2); return 2;} // Nobody answers
+
+    uint8_t f = fault_();
+
+    if (f == 2 || f == 4) {transfer_(addr, reg, 0, false, f); return f;} // No register reached
+    if (f == 3) {len = len / 2;}                                        // NACK in the middle of the data
+
+    advance_();
+    for (uint8_t i = 0; i < len; i++) {store_(reg + i, data[i]);}       // Auto-increment
+    transfer_(addr, reg, len, false, f);
+    return f;
+}
+
+uint8_t QN800x_SimBus::read(uint8_t addr, uint8_t reg, uint8_t *data, uint8_t len)
+{
+    if (addr != address || fault_()) {transfer_(addr, reg, 0, true, 2); return 0;}
+
+    advance_();
+    for (uint8_t i = 0; i < len; i++) {data[i] = (reg + i < SIM_REGS) ? regs[reg + i] : 0;}
+    transfer_(addr, reg, len, true, 0);
+    return len;
+}
+
+//-------------------Fault Injection Section--------------------
+
+void QN800x_SimBus::injectFault(uint8_t count, uint8_t status)
+{
+    faultN = count;
+    faultStatus = status;
+}
+
+void QN800x_SimBus::hang()
+{
+    hung = true;
+}
+
+bool QN800x_SimBus::recover()
+{
+    recoveries++;
+    hung = false;
+    return true;
+}
+
+uint8_t QN800x_SimBus::fault_()
+{
+    if (inReset && (uint32_t) (micros() - resetT) < SIM_RESET_US) return 2; // Busy with the reset
+    inReset = false;
+
+    if (hung) return 4;
+    if (faultN == 0) return 0;
+    faultN--;
+    return faultStatus;
+}
+
+//-------------------Transaction Log Section--------------------
+
+uint16_t QN800x_SimBus::events()
+{
+    return logN;
+}
+
+const QN800x_SimEvent &QN800x_SimBus::event(uint16_t i)
+{
+    return log[(logHead + SIM_LOG_LEN - 1 - i) % SIM_LOG_LEN];
+}
+
+void QN800x_SimBus::clearLog()
+{
+    logHead = 0;
+    logN = 0;
+}
+
+//-------------------Multiplexer Section------------------------
+
+QN800x_SimMux::QN800x_SimMux(uint8_t addr)
+{
+    address = addr;
+    selected = 0;                       // All channels off after power up
+    clockHz = 400000;
+    busUs = 0;
+    for (uint8_t i = 0; i < 8; i++) {chip[i] = NULL;}
+}
+
+void QN800x_SimMux::attach(uint8_t channel, QN800x_SimBus &c)
+{
+    if (channel > 7) return;
+    chip[channel] = &c;
+    c.setBusClock(0);                   // The mux accounts the bus time
+}
+
+void QN800x_SimMux::setBusClock(uint32_t hz)
+{
+    clockHz = hz;
+}
+
+void QN800x_SimMux::busy_(uint8_t len, bool rd)
+{
+    uint32_t us = xferUs_(len, rd, clockHz);
+    busUs += us;
+    simBusy_(us);
+}
+
+uint8_t QN800x_SimMux::write(uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t len)
+{
+    if (addr == address) {selected = reg; busy_(0, false); return 0;} // Control byte only
+
+    uint8_t status = 2;                 // Wired ACK: one chip answering is enough
+
+    busy_(len, false);
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        if (bitRead(selected, i) && chip[i] && chip[i]->write(addr, reg, data, len) == 0) status = 0;
+    }
+
+    return status;
+}
+
+uint8_t QN800x_SimMux::read(uint8_t addr, uint8_t reg, uint8_t *data, uint8_t len)
+{
+    busy_(len, true);
+
+    if (addr == address || selected == 0 || (selected & (selected - 1))) return 0; // Nobody or a bus fight
+
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        if (bitRead(selected, i) && chip[i]) return chip[i]->read(addr, reg, data, len);
+    }
+
+    return 0;
+}
+
+bool QN800x_SimMux::recover()
+{
+    selected = 0;                       // A bus reset resets the mux as well
+    return true;
+}
+
+uint32_t QN800x_SimMux::busTime()
+{
+    return busUs;
+}
+
+uint8_t QN800x_SimMux::getSelected()
+{
+    return selected;
+}
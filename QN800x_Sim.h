@@ -0,0 +1,153 @@
+/*
+QN8007 & QN8006 I2C FM Transmitter Library - Simulated QN800x
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+QN800x_SimBus is a QN800x_Bus with a QN8006/QN8007 model behind it instead of
+a real chip. It keeps the register file 0x00...0x5A, handles the software reset,
+and models the RDS handshake: toggling the RDS ready bit in SYSTEM1 hands RDS0...
+RDS7 over, the chip fetches them at the next group boundary (every 87.579 ms once
+TX and RDS are enabled) and toggles RDS_TXUPD in STATUS3. Every transaction is
+logged with a time stamp. With useVirtualTime() a desktop host runs QN800x_TX on
+simulated time, so hours of RDS traffic take seconds.
+
+Author: Semir Nouri, December 2024
+
+*/
+
+#ifndef QN800x_Sim_h
+#define QN800x_Sim_h
+
+#include <QN800x_Bus.h>
+
+#define SIM_REGS    0x5B        /* Registers 0x00...0x5A                              */
+#define SIM_LOG_LEN 64          /* Number of bus transactions kept in the log         */
+#define SIM_POLL_US 4           /* Virtual time used by each micros() call of the host */
+#define SIM_RESET_US 10000      /* Time the chip does not answer after a software reset */
+
+struct QN800x_SimEvent
+{
+    uint32_t t;                 // micros() time stamp at the end of the transaction
+    uint8_t addr;               // I2C address
+    uint8_t reg;                // Start register
+    uint8_t len;                // Number of data bytes
+    bool read;                  // true for a read, false for a write
+    uint8_t status;             // 0 = ACK, 2 = address NACK
+};
+
+class QN800x_SimBus : public QN800x_Bus
+{
+
+public:
+
+    QN800x_SimBus(uint8_t address = 0x2B);
+
+    uint8_t write(uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t len);
+    uint8_t read(uint8_t addr, uint8_t reg, uint8_t *data, uint8_t len);
+    bool recover();
+
+    void powerUp();                     // All registers back to power up values
+    void setChipID(uint8_t cid2);       // CID2 after power up, e.g. CID_QN800XL << 2 for an "L" part
+    void setBusClock(uint32_t hz);      // Bus clock for transfer times, e.g. 100000 or 400000, 0 = no bus time
+#ifndef ARDUINO
+    void useVirtualTime(bool on);       // Run millis()/micros()/delay() of the host on simulated time
+#endif
+
+    uint8_t peek(uint8_t reg);          // Register value without a bus transaction
+    uint32_t busTime();                 // Total µs the bus was busy
+
+    // Fault injection
+
+    void injectFault(uint8_t count, uint8_t status); // The next count transactions fail with status 2, 3 or 4
+    void hang();                        // Bus stuck until recover(), every transaction fails with 4
+    uint32_t recoveries;                // Number of recover() calls
+
+    // RDS model counters
+
+    uint32_t groupsSent;                // Groups fetched from RDS0...RDS7 and put on air
+    uint32_t groupsRepeated;            // Group boundaries without new data, the last group was repeated
+    uint32_t groupsLost;                // Groups overwritten before the chip fetched them
+
+    void (*onGroup)(const uint8_t group[8], uint32_t t);  // Called for every new group going on air
+    void (*onTransfer)(const QN800x_SimEvent &e);         // Called for every bus transaction
+
+    // Transaction log
+
+    uint16_t events();                  // Number of logged transactions, at most SIM_LOG_LEN
+    const QN800x_SimEvent &event(uint16_t i); // i = 0 is the latest transaction
+    void clearLog();
+
+private:
+
+    uint8_t address;                    // I2C address the simulated chip answers to
+    uint8_t regs[SIM_REGS];             // Register file
+    uint8_t pending[8];                 // Group handed over by the RDS ready toggle
+    bool pendingValid;                  // pending[] not yet fetched
+    bool rdsOn;                         // TX and RDS enabled, group clock running
+    uint32_t nextGroupT;                // micros() time of the next group boundary
+    uint32_t clockHz;                   // Bus clock
+    uint32_t busUs;                     // Total bus time
+    uint8_t cid;                        // CID2 power up value
+    uint32_t resetT;                    // micros() time of the last software reset
+    bool inReset;                       // Software reset not over yet
+    uint8_t faultN;                     // Number of transactions still to fail
+    uint8_t faultStatus;                // Status returned by failing transactions
+    bool hung;                          // Bus stuck
+
+    QN800x_SimEvent log[SIM_LOG_LEN];   // Ring buffer of transactions
+    uint16_t logHead;                   // Next entry to write
+    uint16_t logN;                      // Number of valid entries
+
+    void advance_();                    // Run the group clock up to now
+    uint8_t fault_();                   // Status of an injected fault, 0 = none
+    void store_(uint8_t reg, uint8_t val); // Register write with side effects
+    void transfer_(uint8_t addr, uint8_t reg, uint8_t len, bool rd, uint8_t status); // Bus time and log
+
+};
+
+/* Simulated TCA9548 with up to 8 simulated QN800x behind it. The mux models the
+ * bus time of every transaction once, also when a write reaches several chips.
+ */
+
+class QN800x_SimMux : public QN800x_Bus
+{
+
+public:
+
+    QN800x_SimMux(uint8_t address = 0x70);
+
+    void attach(uint8_t channel, QN800x_SimBus &chip); // chip on channel 0...7
+    void setBusClock(uint32_t hz);      // See QN800x_SimBus::setBusClock()
+
+    uint8_t write(uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t len);
+    uint8_t read(uint8_t addr, uint8_t reg, uint8_t *data, uint8_t len);
+    bool recover();
+
+    uint32_t busTime();                 // Total µs the bus was busy
+    uint8_t getSelected();              // Enabled channels
+
+private:
+
+    uint8_t address;                    // I2C address of the mux
+    uint8_t selected;                   // Enabled channels
+    QN800x_SimBus *chip[8];             // Chips on the channels
+    uint32_t clockHz;                   // Bus clock
+    uint32_t busUs;                     // Total bus time
+
+    void busy_(uint8_t len, bool rd);   // Account the bus time of one transaction
+
+};
+
+#endif
@@ -29,16 +29,53 @@ Author: Semir Nouri, December 2024
 
 */
 
-#include <Arduino.h>
 #include <QN800x_TX.h>
-#include <Wire.h>
 
+#if QN800X_STATS
+#define STATS_ADD(field, n) stats.field += (n)
+#else
+#define STATS_ADD(field, n)
+#endif
+
+#ifdef ARDUINO
+
+static QN800x_WireBus wireBus(Wire); // Default transport, the QN800x on Wire
 
 QN800x_TX::QN800x_TX()
 {
+    bus = &wireBus;
     I2C_address = 0x2B; // QN8007 & QN8006 I2C address
-    uint8_t buf[32]; // Buffer for data sent to I2C registers
-        
+    init_();
+}
+
+#endif
+
+QN800x_TX::QN800x_TX(QN800x_Bus &b, uint8_t address)
+{
+    bus = &b;           // Wire, Linux i2c-dev or the simulated QN800x
+    I2C_address = address;
+    init_();
+}
+
+void QN800x_TX::init_()
+{
+    shValid = 0;        // Shadow registers are fetched from the QN800x when first needed
+    memset(shadow, 0, sizeof(shadow));
+    shDirty = 0;        // No register changes pending
+    updDepth = 0;       // Not inside beginUpdate()/commitUpdate()
+    busErr = 0;         // No failed transaction yet
+    busFails = 0;
+    busRecov = false;
+    chip = CHIP_UNKNOWN; // Not detected, everything enabled as in earlier versions
+    chipID = 0;
+    rdsCap = true;
+    startUs = 0;
+#if QN800X_STATS
+    resetStats();
+    waitDepth = 0;
+#endif
+
+#if QN800X_RDS
     rdsPI_h = 0b11010000; // RDS PI code high byte*
     rdsPI_l = 0b00100010; // RDS PI code low byte*
 
@@ -53,57 +90,491 @@ QN800x_TX::QN800x_TX()
     pstxC = 0; // Completed PS transmissions counter
     rttxC = 0; // Completed RT transmissions counter
 
+    rdsMode = RDS_IDLE; // Non-blocking RDS engine starts without a queued sequence
+    rdsGrpC = 0;
+    rdsLastT = 0;
+    rdsPollT = 0;
+    rdsFreeT = 0;
+    rdsMissed = 0;
+    rdsPace = RDS_PACE_TIMER; // Exact group timing by default
+    rdsFree = true;           // No group pending after power up
+    rdsUpd = false;
+    rdsPTY = 0;
+    rdsB0 = false;
+    rdsStereo = false;
+    rdsAB = false;
+
+    static const uint8_t af[] = {227, 102, 64, 203, 205, 205, 205, 205}; 
+
+    /* Explanation: The above sets alternative frequencies (AF) for A0 group only.
+     * The first item sets number of following AFs 225 = 1, 226 = 2... the first 
+     * should be the frequency of this station, followed by several AF. Here two
+     * have been added. Frequencies are coded by numbers:  1 = 87.6, 2 = 87.7
+     * 3 = 87.8...204 = 107.9. 205 is a dummy code for "no frequency.
+     * Use setRDS_AF() to send your own list.
+     */
 
+    for (uint8_t i = 0; i < 8; i++) {rdsAF[i] = af[i];}
+
+    psSeg = 0;
+    rtSeg = 0;
+    setRDSweights(40, 15, 0); // PS 40%, RT 15% as recommended, the rest is not used yet
+
+    memset(psImg, ' ', sizeof(psImg)); // Blank PS and RT until the first load
+    memset(rtImg, ' ', sizeof(rtImg));
+    rtB = false;      // 2A groups with 64 characters
+    rtIncr = false;   // Send all segments of the text
+    rtSegN = 1;       // Empty text, just the end marker
+    rtDirty = 0;
+    rtSeqMask = 0;
+    rdsTP = false;    // No traffic programme
+    rdsTA = false;    // No traffic announcement
+    rdsMS = true;     // Music, as in earlier versions
+    rdsPre = false;
+    for (uint8_t i = 0; i < RDS_QUEUE; i++) {rdsQ[i].grp = RDS_Q_FREE;}
+    ctLate = 0xFFFFFFFFUL; // No clock time sent yet
+    rdsDropped = 0;
+    rtImg[0][4] = 0x0D;
+    encodePS_();
+    encodeRT_();
+#endif
 }
 
 //-------------------Begin Functions Area-----------------------
 
-void QN800x_TX::SendData_(uint8_t len) 
+bool QN800x_TX::SendBurst_(uint8_t reg, const uint8_t *data, uint8_t len) 
+{
+  for (uint8_t n = 0; ; n++)
+  {
+    uint8_t status = bus->write(I2C_address, reg, data, len); // Straight from the caller's buffer
+#if QN800X_STATS
+    countIO_(reg, len, false, status);
+#endif
+    if (status == 0) return true;
+    if (!retry_(n, status)) return false;
+  }
+}
+
+uint8_t QN800x_TX::ReadRegs_(uint8_t reg, uint8_t *dst, uint8_t len) 
+{
+  for (uint8_t n = 0; ; n++)
+  {
+    uint8_t got = bus->read(I2C_address, reg, dst, len);
+#if QN800X_STATS
+    countIO_(reg, got, true, got == len ? 0 : 4);
+#endif
+    if (got == len || !retry_(n, 4)) return got; // Number of registers actually read
+  }
+}
+
+/* A write the QN800x did not acknowledge, or a short read, is repeated up to
+ * BUS_RETRIES times with a doubling pause, noise bursts from the PA are short.
+ * If it still fails the bus is taken as hung: the transport clocks it free,
+ * the known setup is written to the QN800x again and the transaction gets one
+ * last try. Only then the error is reported through getBusError().
+ */
+
+bool QN800x_TX::retry_(uint8_t n, uint8_t status) // Attempt n failed, true = try again
+{
+  if (n < BUS_RETRIES)
+  {
+    STATS_ADD(retries, 1);
+    wait_(BUS_BACKOFF_US << n);
+    return true;
+  }
+
+  if (n == BUS_RETRIES && recover_()) return true;  // One more try on the recovered bus
+
+  busErr = status;
+  busFails++;
+  STATS_ADD(failed, 1);
+  return false;
+}
+
+bool QN800x_TX::recover_() // Free a hung bus and write the known setup again
+{
+  if (busRecov) return false;           // Failed while restoring, give up instead of recursing
+  if (!bus->recover()) return false;
+
+  STATS_ADD(recoveries, 1);
+  busRecov = true;
+  restore_();
+  busRecov = false;
+  return true;
+}
+
+void QN800x_TX::restore_() // Write all known shadow registers
+{
+  uint32_t todo = shValid & SH_ALL;
+  uint8_t i = 0;
+
+  while (i < SH_LEN)
+  {
+    if (!bitRead(todo, i)) {i++; continue;}
+
+    uint8_t last = i;
+    while (last < RDSFDEV && bitRead(todo, last + 1)) {last++;}
+
+    SendBurst_((i == SH_XLT3) ? REG_XLT3 : (i == SH_PAG_CAL) ? PAG_CAL : i, shadow + i, last - i + 1);
+    i = last + 1;
+  }
+}
+
+uint8_t QN800x_TX::getBusError(bool reset) // Error code of the last transaction that failed for good
+{
+  uint8_t err = busErr;
+  if (reset) {busErr = 0;}
+  return err;
+}
+
+/* Every time the library keeps the caller waiting goes into delayMs of the stats:
+ * the bus backoff, the hop settle time, bbReset() and the blocking RDS calls.
+ * A blocking call counts its whole time once, the waits inside it are not added.
+ */
+
+void QN800x_TX::wait_(uint32_t us) 
+{
+  if (us >= 1000) delay(us / 1000);
+  delayMicroseconds(us % 1000);
+#if QN800X_STATS
+  waited_(us);
+#endif
+}
+
+uint32_t QN800x_TX::blockBegin_()
+{
+#if QN800X_STATS
+  waitDepth++;
+#endif
+  return micros();
+}
+
+void QN800x_TX::blockEnd_(uint32_t t0)
+{
+#if QN800X_STATS
+  waitDepth--;
+  waited_(micros() - t0);
+#else
+  (void) t0;
+#endif
+}
+
+#if QN800X_STATS
+void QN800x_TX::waited_(uint32_t us)
+{
+  if (waitDepth) return;              // Counted by the blocking call around it
+
+  us += waitRest;
+  stats.delayMs += us / 1000;
+  waitRest = us % 1000;
+}
+#endif
+
+uint8_t QN800x_TX::ReadReg_(uint8_t reg) 
+{
+  uint8_t val = 0;
+  ReadRegs_(reg, &val, 1);
+  return val;
+}
+
+//-------------------Register Shadow Section--------------------
+
+/* All writable setup registers are kept in shadow[]. Setters change bits in the
+ * shadow copy and write the result, so no read-modify-write bus cycles are needed.
+ * A register is fetched from the QN800x only once, the first time it is needed,
+ * or all at once by resync(). Index = register address for 0x00...0x18, REG_XLT3
+ * and PAG_CAL follow at SH_XLT3 and SH_PAG_CAL.
+ * With QN800X_SHADOW 0 the copy is not trusted for reads: every setter reads the
+ * register again, as if something else wrote to the QN800x as well. Writes are
+ * still collected and burst, and a recovery still restores what was written.
+ */
+
+uint8_t QN800x_TX::shIdx_(uint8_t reg) // Shadow index of a register
+{
+    if (reg == REG_XLT3) return SH_XLT3;
+    if (reg == PAG_CAL) return SH_PAG_CAL;
+    return reg;
+}
+
+uint32_t QN800x_TX::cached_() // Shadow registers that are used without reading the QN800x
+{
+#if QN800X_SHADOW
+    return shValid;                                     // Everything known
+#else
+    return shDirty;                                     // Only pending changes, everything else is read again
+#endif
+}
+
+uint8_t QN800x_TX::getReg_(uint8_t reg) // Shadow value of a register, fetched from the QN800x if unknown
+{
+    uint8_t i = shIdx_(reg);
+
+    if (!bitRead(cached_(), i)) 
+    {
+        if (ReadRegs_(reg, shadow + i, 1) == 1) bitSet(shValid, i); // Stays unknown if the read failed
+    }
+
+    return shadow[i];
+}
+
+bool QN800x_TX::syncRegs_(uint8_t reg, uint8_t len) // Make sure registers reg...reg+len-1 are known, one burst read
+{
+    uint8_t i = shIdx_(reg);
+    uint8_t j;
+
+    uint32_t known = cached_();
+    for (j = 0; j < len; j++) {if (!bitRead(known, i+j)) break;}
+    if (j == len) return true;                          // All known already
+
+    uint8_t rbuf[RDSFDEV + 1];                          // Read buffer for QN800x Register data
+    if (ReadRegs_(reg, rbuf, len) != len) return false;
+
+    for (j = 0; j < len; j++)                           // Pending changes win over the chip's value
+    {
+        if (!bitRead(known, i+j)) {shadow[i+j] = rbuf[j]; bitSet(shValid, i+j);}
+    }
+
+    return true;
+}
+
+void QN800x_TX::writeReg_(uint8_t reg, uint8_t val) // Write one register through the shadow
+{
+    uint8_t i = shIdx_(reg);
+
+    shadow[i] = val;
+    bitSet(shValid, i);
+    bitSet(shDirty, i);
+
+    if (updDepth == 0) flush_();                        // Not inside beginUpdate()/commitUpdate(), write now
+}
+
+bool QN800x_TX::sendReg_(uint8_t reg) // Write one shadow register at once, also inside an update
+{
+    uint8_t i = shIdx_(reg);
+
+    bitClear(shDirty, i);
+    if (SendBurst_(reg, shadow + i, 1)) return true;
+
+    bitSet(shDirty, i);                                 // Failed for good, the next flush tries again
+    return false;
+}
+
+bool QN800x_TX::flush_(uint32_t *sent) // Write all dirty shadow registers in as few auto-increment bursts as possible
+{
+    uint8_t i = 0;
+    bool ok = true;
+
+    while (i < SH_LEN)
+    {
+        if (!bitRead(shDirty, i)) {i++; continue;}
+
+        uint8_t last = i;                               // Last register of this burst
+
+        /* Extend the burst over following dirty registers. A short gap of clean
+         * registers is bridged by rewriting their known value, which is cheaper
+         * than stop, start, I2C address and sub address of a new transaction.
+         * Only registers in SH_BRIDGE are rewritten this way, REG_XLT3 and PAG_CAL
+         * are not adjacent to anything. With QN800X_SHADOW 0 nothing is bridged,
+         * the QN800x may hold something else by now.
+         */
+
+        for (uint8_t j = i + 1; j <= RDSFDEV && j - last <= SH_GAP + 1; j++)
+        {
+            if (bitRead(shDirty, j)) {last = j; continue;}
+            if (!bitRead(cached_() & SH_BRIDGE, j)) break;
+        }
+
+        uint8_t reg = (i == SH_XLT3) ? REG_XLT3 : (i == SH_PAG_CAL) ? PAG_CAL : i; // Start sub address
+        for (uint8_t j = i; j <= last; j++) {bitClear(shDirty, j);}
+        if (sent) {for (uint8_t j = i; j <= last; j++) {bitSet(*sent, j);}} // Also when it fails, some bytes may have arrived
+
+        if (!SendBurst_(reg, shadow + i, last - i + 1)) // Straight from the shadow, failed for good: keep them for the next flush
+        {
+            for (uint8_t j = i; j <= last; j++) {bitSet(shDirty, j);}
+            ok = false;
+        }
+
+        i = last + 1;
+    }
+
+    return ok;
+}
+
+void QN800x_TX::beginUpdate() // Collect register changes instead of writing them one by one
+{
+    updDepth++;
+}
+
+bool QN800x_TX::commitUpdate() // Write all changes since beginUpdate() in a minimum of bursts
+{
+    if (updDepth > 0) updDepth--;
+    if (updDepth == 0) return flush_();                 // Outermost commit writes everything
+    return true;
+}
+
+bool QN800x_TX::resync() // Read all shadow registers from the QN800x again
+{
+    shValid = 0;                                        // Nothing is trusted until it was read back
+
+    if (ReadRegs_(SYSTEM0, shadow, RDSFDEV + 1) != RDSFDEV + 1) return false; // 0x00...0x18 in one burst
+    if (ReadRegs_(REG_XLT3, shadow + SH_XLT3, 1) != 1) return false;
+    if (ReadRegs_(PAG_CAL, shadow + SH_PAG_CAL, 1) != 1) return false;
+
+    shValid = SH_ALL;
+    return true;
+}
+
+//-------------------Start Up Section---------------------------
+
+/* begin() replaces swReset() plus a blind delay(500) plus one transaction per
+ * setting. After the reset it polls until the QN800x answers with its reset bit
+ * cleared, reads CID2 to find "L" parts without RDS, reads all registers in one
+ * burst and writes the complete setup in a few auto-increment bursts. A warm
+ * restart skips the reset and writes a snapshot saved with saveSnapshot().
+ * getStartupTime() tells how long it took.
+ */
+
+bool QN800x_TX::waitReady_() // Poll the QN800x until it is out of reset
+{
+    uint8_t r[CID2 + 1];
+    uint32_t t0 = millis();
+
+    do
+    {
+        // Raw bus access, NACKs are expected during reset and neither retried nor counted
+        if (bus->read(I2C_address, SYSTEM0, r, CID2 + 1) == CID2 + 1 && !bitRead(r[SYSTEM1], 7) && r[CID2] != 0 && r[CID2] != 0xFF)
+        {
+            chipID = r[CID2];
+            uint8_t id = chipID >> 2;
+
+            chip = (id == CID_QN800X) ? CHIP_QN800X : (id == CID_QN800XL) ? CHIP_QN800XL : CHIP_UNKNOWN;
+            rdsCap = (chip != CHIP_QN800XL);
+#if QN800X_RDS
+            if (!rdsCap) stopRDS();
+#endif
+            return true;
+        }
+
+        wait_(BEGIN_POLL_US);
+    }
+    while ((uint32_t) (millis() - t0) < BEGIN_TIMEOUT_MS);
+
+    chip = CHIP_NONE;
+    return false;
+}
+
+bool QN800x_TX::begin(const QN800x_Setup &setup) // Cold start
+{
+    uint32_t t0 = micros();
+
+    swReset(true);
+    if (!waitReady_()) return false;
+    if (!resync()) return false;             // Power up values in one burst, no read-modify-write below
+
+    beginUpdate();
+    applySetup_(setup);
+    bool ok = commitUpdate();
+
+    startUs = micros() - t0;
+    return ok;
+}
+
+void QN800x_TX::applySetup_(const QN800x_Setup &setup) // All setters of a setup, collected by the caller's update
+{
+    setExtClk(setup.extClk);
+    tuneXtal_Rin(setup.xtune, setup.impedance);
+    setDeviation(setup.deviation);
+    setDevPilot(setup.devPilot);
+    setDevRDS(setup.devRDS);
+    if (setup.power <= 15) setPower(setup.power);
+    initTransmit(setup.stereo, setup.I2S, setup.RDS);
+#if QN800X_I2S
+    if (setup.I2S && setup.i2sRate) setI2S(setup.i2sMaster, setup.i2sRate, setup.i2sBits, setup.i2sFormat);
+#endif
+    setFrequency(setup.frequency);
+}
+
+bool QN800x_TX::begin(const QN800x_Snapshot &snap) // Warm restart
+{
+    uint32_t t0 = micros();
+
+    if (!waitReady_()) return false;
+
+    memcpy(shadow, snap.regs, SH_LEN);
+    bitClear(shadow[SYSTEM1], 7);                // Never replay a reset
+    if (!rdsCap) bitClear(shadow[SYSTEM0], 1);   // Snapshot of a different part
+    shValid = snap.valid & SH_ALL;
+    shDirty = shValid;                           // Everything, the QN800x may have lost power
+    bool ok = flush_();
+
+    startUs = micros() - t0;
+    return ok;
+}
+
+void QN800x_TX::saveSnapshot(QN800x_Snapshot &snap)
+{
+    memcpy(snap.regs, shadow, SH_LEN);
+    snap.valid = shValid & SH_ALL;
+}
+
+uint8_t QN800x_TX::getChip()
+{
+    return chip;
+}
+
+uint8_t QN800x_TX::getChipID()
+{
+    return chipID;
+}
+
+bool QN800x_TX::hasRDS()
+{
+    return rdsCap && QN800X_RDS;
+}
+
+uint32_t QN800x_TX::getStartupTime()
 {
-  Wire.beginTransmission(I2C_address);
-  for (uint8_t i = 0; i < len; i++) { Wire.write(buf[i]);}
-  Wire.endTransmission();
+    return startUs;
 }
 
+//-------------------Setup Functions Section--------------------
+
 void QN800x_TX::swReset(bool reset) // Reset the QN800x
 {
-	buf[0] = SYSTEM1;  // Start sub address SYSTEM1 address: 01h
-	
-	if (reset) bitSet (buf[1], 7); // Set reset bit	
-	
-    SendData_(2);
+    if (!reset) return;
+
+    bitSet(shadow[SYSTEM1], 7);                       // Set reset bit, other bits are reset anyway
+    sendReg_(SYSTEM1);                                // At once, even inside beginUpdate()/commitUpdate()
+
+    shValid = 0;                                      // All registers are back to their power up values
+    shDirty = 0;
 }
 
 void QN800x_TX::bbReset(uint8_t gap)
 {    
-	buf[0] = ANACTL1; // ANACTL1 address: 03h 
-    uint8_t rbuf[8]; // Read buffer for QN800x Register data
-
-    Wire.requestFrom(I2C_address, 8); 
-    for (uint8_t i = 0; i < 8; i++) {rbuf[i] = Wire.read ();} // rbuf = Read Buffer for register values read from QN8007
-    	    
-    buf[1] = bitClear (rbuf[5], 5);   // Reset active
-	  
-	SendData_(2);
+    getReg_(ANACTL1);                       // ANACTL1 address: 03h
 
-    delay(gap);
+    /* Both edges go out at once, also inside beginUpdate()/commitUpdate(),
+     * a collected update would only write the final value and never reset.
+     */
 
-    Wire.requestFrom(I2C_address, 8); 
-    for (uint8_t i = 0; i < 8; i++) {rbuf[i] = Wire.read ();} // rbuf = Read Buffer for register values read from QN8007
+    bitClear(shadow[ANACTL1], 5);
+    sendReg_(ANACTL1);                      // Reset active
 
-    buf[1] = bitSet (rbuf[5], 5); // Deactivate reset
+    wait_(gap * 1000UL);
 
-    SendData_(2);
+    bitSet(shadow[ANACTL1], 5);
+    sendReg_(ANACTL1);                      // Deactivate reset
 }
 
 void QN800x_TX::setExtClk(bool ext) // Choose to operate on external clock
 {
-	buf[0] = REG_XLT3; // Start sub address REG_XLT3
-	
-	if (ext)  buf[1] = 0b00010100; // Set bit for external XCLK input pin 16
-	if (!ext) buf[1] = 0b00000100; // Use internal crystal oscillator
+	uint8_t xlt3 = getReg_(REG_XLT3) | 0b00000100; // Keep the other bits of REG_XLT3
+
+	if (ext)  bitSet (xlt3, 4);   // Set bit for external XCLK input pin 16
+	if (!ext) bitClear (xlt3, 4); // Use internal crystal oscillator
 	
-	SendData_(2);
+	writeReg_(REG_XLT3, xlt3);
 }
 
 void QN800x_TX::setXtal(uint8_t xtal) // Set up frequency of used clock crystal
@@ -115,13 +586,11 @@ void QN800x_TX::setXtal(uint8_t xtal) // Set up frequency of used clock crystal
   *             11 is the default use with this software!
   */	  
   
-  buf[0] = ANACTL1;  // ANACTL1 Address: 03h 
-  
-    if (((xtal >= 0) && (xtal < 7)) || ((xtal > 7) && (xtal <= 15))) 
-    {buf[1] = 0b00100000 | xtal;}
-    else buf[1] = 0b00101011;      // Default frequency 26 MHz
+    if (xtal == 7 || xtal > 15) xtal = 11;  // Default frequency 26 MHz
+
+    uint8_t anactl = getReg_(ANACTL1) & 0b11010000; // Keep mute and the other upper bits of ANACTL1
 
-  SendData_(2);
+    writeReg_(ANACTL1, anactl | 0b00100000 | xtal); // Base band out of reset, crystal selection in lower 4 bits
 }
 
 void QN800x_TX::tuneXtal_Rin(uint8_t xtune, uint8_t impedance) // Fine tune crystal frequency
@@ -129,172 +598,246 @@ void QN800x_TX::tuneXtal_Rin(uint8_t xtune, uint8_t impedance) // Fine tune crys
     // Use 0...61 to get most precise output frequency, depends on crystal
     // use 0-3 equals 10k, 20k, 40k, 80k input impedance
 	
-    buf[0] = REG_VGA;                   // Register REG_VGA for setting analog input impedance and crystal cap
-	
-    uint8_t xtuneL = xtune & 0b0011111; // protect upper two bits
-    uint8_t impH = impedance << 6;      // Shift value up by 6 bits so the highest two bits get altered
-    buf[1] = impH | xtuneL;             // Add together the two settings and write to buffer	
-
-	SendData_(2);
+    // xtune in the lower 6 bits (upper two protected), impedance in the highest two bits
+    writeReg_(REG_VGA, QN800X_VGA(xtune, impedance)); // Register REG_VGA for setting analog input impedance and crystal cap
 }
 
 void QN800x_TX::initTransmit(bool stereo, bool I2S, bool RDS) // Set up transmitter mode
 {
-  	
-  	buf[0] = SYSTEM0;       // Start sub address SYSTEM1 address: 00h
-  	buf[1] = 0b01000001;    // Enter Transmitting mode. CH is determined by the content in CH[9:0].
-  	buf[2] = 0b00000011;    // Set STEREO set pre-emphasis to 50µs & set IDLE to infinity
+  	uint8_t sys0 = 0b01000001;    // Enter Transmitting mode. CH is determined by the content in CH[9:0].
+  	uint8_t sys1 = 0b00000011;    // Set STEREO set pre-emphasis to 50µs & set IDLE to infinity
  
-    if (stereo) bitClear (buf[2], 4);   // Set to stereo mode
-   	if (!stereo) bitSet (buf[2], 4);    // Set to mono mode
+    if (stereo) bitClear (sys1, 4);   // Set to stereo mode
+   	if (!stereo) bitSet (sys1, 4);    // Set to mono mode
 
-	if (I2S) bitSet (buf[1], 2);        // Set to digital I2S input
-   	if(!I2S) bitClear (buf[1], 2);      // Set to analog input	
+	if (I2S && QN800X_I2S) bitSet (sys0, 2);    // Set to digital I2S input
+   	if (!I2S || !QN800X_I2S) bitClear (sys0, 2); // Set to analog input	
 
-	if (RDS) bitSet (buf[1], 1);        // Enable RDS
-   	if (!RDS) bitClear (buf[1], 1);     // Disable RDS	
+	if (RDS && rdsCap && QN800X_RDS) bitSet (sys0, 1);     // Enable RDS, not on "L" parts
+   	if (!RDS || !rdsCap || !QN800X_RDS) bitClear (sys0, 1); // Disable RDS	
 
-	SendData_(3);
+    beginUpdate();                    // SYSTEM0 and SYSTEM1 in one burst
+    writeReg_(SYSTEM0, sys0);
+    writeReg_(SYSTEM1, sys1 | (getReg_(SYSTEM1) & 0b00000100)); // Leave the RDS ready bit alone
+    commitUpdate();
 }
 
-void QN800x_TX::setFrequency(uint16_t  frequency) // Set transmitting frequency
+bool QN800x_TX::setFrequency(uint16_t  frequency) // Set transmitting frequency
 {
   	// Calculate CH value. Frequency = 76 + CH*0.05 from data sheet
 	// Change formula to CH = (freq-76)/0.05
 	// Multiply all with 10/10 to use all integers instead of float yields CH = (frequency*10-7600)/5
 	// Frequency has to be put in as integer e.g. 107.8MHz input is 1078
 
-	uint16_t frequencyB = (frequency*10 - 7600)/5; 
-	uint8_t frequencyH = frequencyB >> 8;   // Calculate two upper frequency bits for register 0x0B
-	uint8_t frequencyL = frequencyB & 0xFF; // Calculate low 8 bits for register 0x08
-  
-    buf[0] = CH;                            // Start sub address 
-    buf[1] = frequencyL;                    // Send lower 8 bits of frequency value
-  
-    SendData_(2);
-  
-    buf[0] = CH_STEP;                       // Start sub address 
-    buf[1] = frequencyH;                    // Send upper 2 bits of frequency value
+	if (frequency < FREQ_MIN || frequency > FREQ_MAX) return false; // Would wrap to a random channel
+
+	setChannel_(QN800X_CHANNEL(frequency));
+    return true;
+}
+
+void QN800x_TX::setChannel_(uint16_t ch) // CH and CH_STEP register by register, inside an update
+{
+	uint8_t frequencyH = ch >> 8;           // Calculate two upper frequency bits for register 0x0B
+	uint8_t frequencyL = ch & 0xFF;         // Calculate low 8 bits for register 0x08
   
-	SendData_(2);
+    syncRegs_(CH, 4);                       // Know 0x08...0x0B, so CH and CH_STEP go out in one burst
+
+    beginUpdate();                          // No moment with new low bits but old high bits
+    writeReg_(CH, frequencyL);              // Send lower 8 bits of frequency value
+    writeReg_(CH_STEP, (getReg_(CH_STEP) & 0b11111100) | frequencyH); // Send upper 2 bits, keep the step bits
+    commitUpdate();
+}
+
+uint32_t QN800x_TX::hopChannel(uint16_t ch, bool mute) // Retune at once to a precomputed channel index
+{
+    /* For hopping between site frequencies: no arithmetic, no range check on every
+     * call beyond one compare, CH...CH_STEP go out in one auto-increment burst even
+     * inside beginUpdate(). With mute the audio is off while the PLL moves, so the
+     * hop makes no click. Returns the time the hop took in µs, 0 for an invalid index.
+     */
+
+    if (ch > CH_MAX) return 0;
+
+    uint32_t t0 = micros();
+
+    bool known = syncRegs_(CH, 4);          // 0x09 and 0x0A are rewritten with their known values
+    bool muted = bitRead(getReg_(ANACTL1), 7);
+
+    if (mute && !muted) {bitSet(shadow[ANACTL1], 7); sendReg_(ANACTL1);}
+
+    if (known)
+    {
+        shadow[CH] = ch & 0xFF;
+        shadow[CH_STEP] = (shadow[CH_STEP] & 0b11111100) | (ch >> 8);
+
+        if (SendBurst_(CH, shadow + CH, 4)) shDirty &= ~(0x0FUL << CH); // Pending changes of 0x08...0x0B went out with this burst
+        else {bitSet(shDirty, CH); bitSet(shDirty, CH_STEP);}            // Failed for good, the next flush tries again
+    }
+    else setChannel_(ch);                   // Unknown 0x09...0x0A must not be written, the setFrequency() way
+
+    if (mute && !muted)
+    {
+        wait_(HOP_SETTLE_US);
+        bitClear(shadow[ANACTL1], 7);
+        sendReg_(ANACTL1);
+    }
+
+    return micros() - t0;
 }
 
 void QN800x_TX::setPower(uint8_t power)   // Set RF output power
 {	
-	buf[0] = PAG_CAL;                       // Register for setting output power
-	uint8_t pcon = 0b01000000;              // Disable power gain calibration functions
-    uint8_t powerL = power & 0b00001111;    // lower 4 bits determine power setting
-    buf[1] = pcon | powerL;	
-	
-	SendData_(2);
+	// Bit 6 disables the power gain calibration functions, lower 4 bits determine power setting
+	writeReg_(PAG_CAL, QN800X_PAG(power));  // Register for setting output power
 }
 
 void QN800x_TX::setDeviation(uint8_t totaldev) // Set deviation of multiplex stereo signal
 {
-	buf[0] = TX_FDEV;                            // Register TX_FDEV for setting total deviation
-	buf[1] = totaldev;
-
-	SendData_(2);
+	writeReg_(TX_FDEV, totaldev);           // Register TX_FDEV for setting total deviation
 }
 
 void QN800x_TX::setDevRDS(uint8_t rdsdev) // Set deviation of RDS carrier
 {
-	uint8_t rds7 = rdsdev & 0b01111111;     // Protect the MSB bit if deviation value is over 127
-	buf[0] = RDSFDEV;                       // Register RDSFDEV for setting RDS deviation
-	buf[1] = rds7 | 0b10000000;             // Set MSB to 1 as in the default
-
-	SendData_(2);
+	// Protect the MSB if deviation value is over 127, set it to 1 as in the default
+	writeReg_(RDSFDEV, QN800X_RDSDEV(rdsdev));
 }
 
 void QN800x_TX::setDevPilot(uint8_t pilotdev) // Set deviation of stereo pilot (percent of main deviation)
 {	
-	buf[0] = GAIN_TXPLT; // Register GAIN_TXPLT for setting Pilot deviation as a percentage of 75kHz
-	
-	switch (pilotdev) 
-    {
-	case 7:   buf[1] = 0b00011100; // Set pilot deviation to 7% of 75kHz
-	break;
- 	case 8:   buf[1] = 0b00100000; // Set pilot deviation to 8% of 75kHz
-	break;
-  	case 9:   buf[1] = 0b00100100; // Set pilot deviation to 9% of 75kHz
-	break;
-	case 10: buf[1] = 0b00101000; // Set pilot deviation to 10% of 75kHz
-	break;
-    }
+	if (pilotdev < 7 || pilotdev > 10) return; // Only 7%...10% are valid
 
-	SendData_(2);
+	// Pilot deviation in % of 75kHz goes to bits 7...2 of GAIN_TXPLT, e.g. 9% = 0b00100100
+	uint8_t plt = getReg_(GAIN_TXPLT) & 0b00000011; // Keep the lower two bits
+
+	writeReg_(GAIN_TXPLT, plt | (pilotdev << 2));
 }
 
 void QN800x_TX::setMute(bool mute) 
 {  
-/*	
-  Wire.beginTransmission(I2C_address);
-  Wire.write(ANACTL1);                       // ANACTL1 Address: 03h
-  Wire.endTransmission();
-  Wire.requestFrom(I2C_address, 1);          // Request one Byte
-  buf[1] = Wire.read();
-  if (mute)  buf[1] = buf[1] & 0b01111111;   // Mute
-  if (!mute) buf[1] = buf[1] | 0b10000000;   // Unmute
-  buf[0] = ANACTL1;                          // ANACTL1 Address: 03h
-  SendData_(2);
-
-*/
-
-    uint8_t rbuf[32]; // Read buffer for QN800x Register data
+    uint8_t anactl = getReg_(ANACTL1);              // ANACTL1 address: 03h
 
-    Wire.requestFrom(I2C_address, 8); 
-    for (uint8_t i = 0; i < 8; i++) {rbuf[i] = Wire.read ();} // rbuf = Read Buffer for register values read from QN8007
-    
-    
-	buf[0] = ANACTL1; // ANACTL1 address: 03h
-	    
-    if (mute)  buf[1] = bitSet (rbuf[5], 7);   // Mute
-   	if (!mute) buf[1] = bitClear (rbuf[5], 7); // Unmute
+    if (mute)  bitSet (anactl, 7);   // Mute
+   	if (!mute) bitClear (anactl, 7); // Unmute
 
     // Remark: On QN8007 the mute function only works with bit #5 set to 0 for mute
 	  
-	SendData_(2);
+	writeReg_(ANACTL1, anactl);
 }
 
 
+#if QN800X_I2S
 void QN800x_TX::setDAsrate(uint8_t samprate) // Master mode Audio sampling rate
 {
-	buf[0] = IIS; //Register for I2S setup
-
-	// below configuration sets to 16Bit I2S protocol      
-   	// Below setting will activate master mode
+	// 16Bit I2S protocol in master mode:
 	// the QN8006/7 will supply BCK ad WCK as Master and expect data input
 
-	switch (samprate) 
+	setI2S(true, samprate, 16, I2S_FMT_I2S); // Nothing is written for other rates
+}
+
+bool QN800x_TX::setI2S(bool master, uint8_t rate, uint8_t bits, uint8_t format) // Complete I2S input setup
+{
+    /* IIS register: bits 6:4 sample rate, bit 3 master, bits 2:1 format, bit 0
+     * 16 bit words. As master the QN800x drives BCK and WCK from its own clock.
+     * As slave it takes both from the host, e.g. an ESP32 decoder running at its
+     * own 44.1 or 48 kHz, so no resampling is needed on the host. The rate must
+     * still match the host's WCK, the QN800x sets up its audio path with it.
+     * Nothing is written if an argument is not supported.
+     */
+
+    uint8_t code;
+
+    switch (rate) 
     {
-	case 32: buf[1] = 0b01001001; // Set sample rate to 32kbps in Master mode
-	break;
- 	case 40: buf[1] = 0b01011001; // Set sample rate to 40kbps in Master mode
-	break;
-  	case 44: buf[1] = 0b01101001; // Set sample rate to 44.1kbps in Master mode
-	break;
-	case 48: buf[1] = 0b01111001; // Set sample rate to 48kbps in Master mode
-	break;
+    case 32: code = 0b100; break;   // 32 kHz
+    case 40: code = 0b101; break;   // 40 kHz
+    case 44: code = 0b110; break;   // 44.1 kHz
+    case 48: code = 0b111; break;   // 48 kHz
+    default: return false;
     }
-    	
-	SendData_(2);
+
+    if ((bits != 8 && bits != 16) || format > I2S_FMT_DSP) return false;
+
+    uint8_t iis = getReg_(IIS) & 0b10000000;         // Keep bit 7
+    iis |= (code << 4) | (format << 1);
+    if (master) bitSet(iis, 3);
+    if (bits == 16) bitSet(iis, 0);
+
+    writeReg_(IIS, iis);
+    return true;
 }
+#endif
 
 //------------------------RDS PS section-----------------------------------
 
+#if QN800X_RDS
+
+/* All groups of the carousel are kept ready as 8 byte images of RDS0...RDS7 in
+ * psImg[] and rtImg[]. Images are only encoded again when PS, RT, PTY, PI, AF or
+ * the stereo flag change, so handing a group to the QN800x is one I2C burst
+ * straight from the cache. The PS and RT characters are only stored in the images.
+ */
+
 void QN800x_TX::setRDS_PS(char ps[], uint16_t newPTY, bool useB0, bool stereo) // Send PS using 0A or 0B group format
 {
+    startRDS_PS(ps, newPTY, useB0, stereo); // Queue the 4 PS groups
 
-    uint8_t rbuf[7];   // Read Buffer for register values read from QN8007
-    uint8_t pslc = 0;   // PS Letter Counter for PS twin letters
+    uint32_t t0 = blockBegin_();
+    uint8_t fails = busFails;
+    while (rdsBusy() && busFails == fails) {tick();} // Blocking version: run the RDS engine until the sequence is done
+    blockEnd_(t0);
+}
+
+void QN800x_TX::startRDS_PS(char ps[], uint16_t newPTY, bool useB0, bool stereo) // Queue PS using 0A or 0B group format
+{
+    loadRDS_PS(ps, newPTY, useB0, stereo);  // Update the group images if anything changed
 
-    Wire.requestFrom(I2C_address, 7); 
-    for (uint8_t i = 0; i < 7; i++) {rbuf[i] = Wire.read ();}
+    getReg_(SYSTEM1);                       // Make sure the current state of the RDS ready bit is known
 
-    
-        for (pslc = 0; pslc < 4; pslc++)   
-        {
-    
+    if (rdsMode == RDS_IDLE && rdsFree) {rdsFreeT = micros();} // Host was idle, that is no missed slot
+
+    if (rdsCap) rdsMode = RDS_PS;           // A new sequence replaces one that may still be running
+    rdsGrpC = 0;
+}
+
+void QN800x_TX::loadRDS_PS(char ps[], uint16_t newPTY, bool useB0, bool stereo) // Put new PS data into the group cache
+{
+    bool changed = (newPTY != rdsPTY);
+
+    if (changed) {rdsPTY = newPTY; encodeRT_();}           // PTY is part of every group
+
+    if (useB0 != rdsB0 || stereo != rdsStereo) {rdsB0 = useB0; rdsStereo = stereo; changed = true;}
+
+    for (uint8_t pslc = 0; pslc < 4; pslc++)                // The letters only live in block D of the images
+    {
+        psImg[pslc][6] = ps[2*pslc];                        // Register 0x16 First letter
+        psImg[pslc][7] = ps[2*pslc+1];                      // Register 0x17 Second letter
+    }
+
+    if (changed) encodePS_();
+}
+
+void QN800x_TX::setRDS_PI(uint16_t pi) // Set the PI code
+{
+    rdsPI_h = pi >> 8;
+    rdsPI_l = pi & 0xFF;
+
+    encodePS_();                            // PI is in block A of every group
+    encodeRT_();
+}
+
+void QN800x_TX::setRDS_AF(uint8_t af[]) // Set the 8 byte AF list sent with 0A groups
+{
+    for (uint8_t i = 0; i < 8; i++) {rdsAF[i] = af[i];}
+
+    encodePS_();                // Only block C of the PS images changes
+}
+
+void QN800x_TX::encodePS_() // Build blocks A, B and C of the 4 PS group images
+{
+    uint16_t pty = rdsPTY << 5; // Move PTY bits to the correct position.
+
+    for (uint8_t pslc = 0; pslc < 4; pslc++) // pslc = PS Letter Counter for PS twin letters
+    {
         uint16_t rdsGrp_0A = 0b0000000000001000; // raw group 0A data. Choose 0A when there are alternative frequencies
 
         /* Explanation for the 16 group 0A bits:
@@ -308,73 +851,38 @@ void QN800x_TX::setRDS_PS(char ps[], uint16_t newPTY, bool useB0, bool stereo) /
          * 0000->Group#, 1 = B0 -> B (0 = A), 0->TP, 00000->PTY, 0->TA, 0->M/S, 0->DI, xx->PS letter counter 00...11
          * 15-12         11                   10     9 - 5       4      3       2      10  Bit number MSB....LSB
          */
-        
-        uint8_t af[] = {227, 102, 64, 203, 205, 205, 205, 205}; 
-
-        /* Explanation: The above sets alternative frequencies (AF) for A0 group only.
-         * The first item sets number of following AFs 225 = 1, 226 = 2... the first 
-         * should be the frequency of this station, followed by several AF. Here two
-         * have been added. Frequencies are coded by numbers:  1 = 87.6, 2 = 87.7
-         * 3 = 87.8...204 = 107.9. 205 is a dummy code for "no frequency.
-         */
-                        
-        uint16_t pty = newPTY << 5; // Move PTY bits to the correct position.
-
-        
 
-        if (pslc == 3 && stereo) {rdsGrp_0A = rdsGrp_0A | 0b0000000000000100;} // Set d0 Bit to 1 = stereo
-        if (pslc == 3 && stereo) {rdsGrp_0B = rdsGrp_0B | 0b0000000000000100;} // Set d0 Bit to 1 = stereo
+        if (pslc == 3 && rdsStereo) {rdsGrp_0A = rdsGrp_0A | 0b0000000000000100;} // Set d0 Bit to 1 = stereo
+        if (pslc == 3 && rdsStereo) {rdsGrp_0B = rdsGrp_0B | 0b0000000000000100;} // Set d0 Bit to 1 = stereo
 
-  
         rdsGrp_0B =  rdsGrp_0B + pslc + pty;       // Add Letter counter and PTY data to group
         rdsGrp_0A =  rdsGrp_0A + pslc + pty;       // Add Letter counter and PTY data to group
-      
-        buf[0] = RDS0;                             // First RDS register address 10h
-        buf[1] = rdsPI_h;                          // Send data for Register 0x10 PI High Byte
-        buf[2] = rdsPI_l;                          // Send data for Register 0x11 PI Low Byte
 
-        if(useB0)
+        rdsGrp_0A = (rdsGrp_0A & ~RDS_FLAGS_0) | rdsFlags_(true); // TP, TA and M/S
+        rdsGrp_0B = (rdsGrp_0B & ~RDS_FLAGS_0) | rdsFlags_(true);
+
+        uint8_t *img = psImg[pslc];
+
+        img[0] = rdsPI_h;                          // Register 0x10 PI High Byte
+        img[1] = rdsPI_l;                          // Register 0x11 PI Low Byte
+
+        if(rdsB0)
         {     					                   // Settings if B0 group is used
-        buf[3] = ((uint8_t) ((rdsGrp_0B) >> 8));   // Send data for Register 0x12 Group High Byte
-        buf[4] = ((uint8_t) ((rdsGrp_0B) & 0xff)); // Send data for Register 0x13 Group Low Byte
-        buf[5] = rdsPI_h;                          // Send data for Register 0x14 PI High Byte repeat
-        buf[6] = rdsPI_l;                          // Send data for Register 0x15 PI Low Byte repeat
+        img[2] = ((uint8_t) ((rdsGrp_0B) >> 8));   // Register 0x12 Group High Byte
+        img[3] = ((uint8_t) ((rdsGrp_0B) & 0xff)); // Register 0x13 Group Low Byte
+        img[4] = rdsPI_h;                          // Register 0x14 PI High Byte repeat
+        img[5] = rdsPI_l;                          // Register 0x15 PI Low Byte repeat
         }
         
-        if(!useB0)
+        if(!rdsB0)
         { 					                       // Settings if A0 group is used 
-        buf[3] = ((uint8_t) ((rdsGrp_0A) >> 8));   // Send data for Register 0x12 Group High Byte
-        buf[4] = ((uint8_t) ((rdsGrp_0A) & 0xff)); // Send data for Register 0x13 Group Low Byte
-        buf[5] = af[2*pslc];                       // Send data for Register 0x14 Alternative Freq. list
-        buf[6] = af[2*pslc+1];                     // Send data for Register 0x15 Alternative Freq. list
+        img[2] = ((uint8_t) ((rdsGrp_0A) >> 8));   // Register 0x12 Group High Byte
+        img[3] = ((uint8_t) ((rdsGrp_0A) & 0xff)); // Register 0x13 Group Low Byte
+        img[4] = rdsAF[2*pslc];                    // Register 0x14 Alternative Freq. list
+        img[5] = rdsAF[2*pslc+1];                  // Register 0x15 Alternative Freq. list
         }   
-
-        buf[7] = ps[2*pslc];                       // Send data for Register 0x16 First letter
-        buf[8] = ps[2*pslc+1];                     // Send data for Register 0x17 Second letter
-        
-        SendData_(9);
-
-       rbuf[3] = rbuf[3] ^ 0b00000100;              // Toggle RDS Ready bit from register 0x01
-
-        buf[0] = SYSTEM1;                            // Register SYSTEM1 contains the RDSReady toggle bit
-        buf[1] = rbuf[3];                            // Send toggled bit to move RT data to QN8007 RDS tx data buffer
-        
-        SendData_(2);
-
-        delay(100);                                   // Delay to allow the QN8007 to transmit the RDS data of one block
-
-        /* The RDS bit rate is 1187.5 kb/s. One full group of 4 blocks has a total of 104 bits
-         * 16 data bits + 10 bits for error correction hence 4 x 26 = 104 bits in a block.
-         * it takes 104b / 1187kb/s = 0.0877s i.e. ~90 ms of transmit time for a group to complete
-         * assuming a few ms of additional processing time at least 90 ms of delay needs to be 
-         * added for an ATMEGa328 running @16MHz.
-         */
-
-        if  (pslc == 3) {pstxC++;} // increase PS completed transmission counter at the end of each 4 block RDS send
-
-        }
-            
-}
+    }
+}
 
 uint8_t QN800x_TX::getPScomplete(bool reset) // Get PS counter value, look for counter reset
 {
@@ -392,67 +900,174 @@ uint8_t QN800x_TX::getPScomplete(bool reset) // Get PS counter value, look for c
      */
 
 
+uint16_t QN800x_TX::rdsFlags_(bool grp0) // TP for all groups, TA and M/S for group 0A/0B, in block B positions
+{
+    uint16_t flags = 0;
+
+    if (rdsTP) flags = flags | 0b0000010000000000;             // Bit 10 TP
+    if (grp0 && rdsTA) flags = flags | 0b0000000000010000;     // Bit 4 TA
+    if (grp0 && rdsMS) flags = flags | 0b0000000000001000;     // Bit 3 M/S, 1 = music
+
+    return flags;
+}
+
+uint32_t QN800x_TX::setRDSflags(uint16_t newPTY, bool tp, bool ta, bool ms) // Change PTY, TP, TA and M/S right now
+{
+    /* Announcements can't wait for the carousel or a running sequence. All cached
+     * images get the new header bits, then the very next group slot is taken by a
+     * PS group, which is the group that carries TA and M/S. The call returns when
+     * that group was handed to the QN800x, i.e. within one group period, with the
+     * time it took in µs. The group goes on air at the next group boundary.
+     */
+
+    uint32_t t0 = micros();
+
+    startRDSflags(newPTY, tp, ta, ms);
+
+    if (!rdsCap) return 0;                  // No RDS on "L" parts
+
+    uint8_t fails = busFails;
+    uint32_t t1 = blockBegin_();
+
+    while (rdsPre && busFails == fails) {tick();} // Wait for the next group slot, give up if the bus failed
+    rdsPre = false;
+
+    blockEnd_(t1);
+
+    return micros() - t0;
+}
+
+void QN800x_TX::startRDSflags(uint16_t newPTY, bool tp, bool ta, bool ms) // Same as setRDSflags(), tick() sends the PS group
+{
+    rdsPTY = newPTY;
+    rdsTP = tp;
+    rdsTA = ta;
+    rdsMS = ms;
+
+    encodePS_();                            // Only the headers, the text is left alone
+    encodeRT_();
+
+    getReg_(SYSTEM1);                       // Make sure the current state of the RDS ready bit is known
+
+    if (rdsMode == RDS_IDLE && !rdsPre && rdsFree) {rdsFreeT = micros();} // Host was idle, that is no missed slot
+
+    if (rdsCap) rdsPre = true;              // The next slot is taken by a PS group
+}
+
+
 //---------------------RDS RT Section---------------------------------
 
 void QN800x_TX::setRDS_RT (char rt[], uint16_t newPTY, bool clrTXT)
 {
-  uint8_t rbuf[7]; // Read Buffer for register values read from QN8007
-  uint8_t rtlc = 0; 
+    startRDS_RT(rt, newPTY, clrTXT);        // Queue the 16 RT groups
 
-  Wire.requestFrom(I2C_address, 7);
-  for (uint8_t i = 0; i < 7; i++) {rbuf[i] = Wire.read ();}
-  
-        for (rtlc = 0; rtlc < 16; rtlc++)   // rtlc = Radio Text Letter Counter for RT quad letters
-        {    
-  
-            uint16_t rdsGrp_2A = 0b0010000000000000; // raw group 2A data. 2A offers 64 characters for RT
+    uint32_t t0 = blockBegin_();
+    uint8_t fails = busFails;
+    while (rdsBusy() && busFails == fails) {tick();} // Blocking version: run the RDS engine until the sequence is done
+    blockEnd_(t0);
+}
+
+void QN800x_TX::startRDS_RT (char rt[], uint16_t newPTY, bool clrTXT)
+{
+    loadRDS_RT(rt, newPTY, clrTXT);         // Update the group images if anything changed
+
+    getReg_(SYSTEM1);                       // Make sure the current state of the RDS ready bit is known
+
+    if (rdsMode == RDS_IDLE && rdsFree) {rdsFreeT = micros();} // Host was idle, that is no missed slot
+
+    uint16_t mask = (uint16_t) ((1UL << rtSegN) - 1); // Segments to send in this sequence
+    if (rtIncr) {mask = rtDirty;}           // Only the changed ones in incremental mode
+    if (mask == 0) return;                  // Same text, nothing to send and no RT transmission to count
+
+    rtSeqMask = mask;
+    if (rdsCap) rdsMode = RDS_RT;           // A new sequence replaces one that may still be running
+    rdsGrpC = 0;
+}
+
+void QN800x_TX::loadRDS_RT (char rt[], uint16_t newPTY, bool clrTXT) // Put new RT data into the group cache
+{
+    /* Only the segments needed for the text are sent. The text ends at the first
+     * NUL or CR or after 64 (2A) or 32 (2B) characters, trailing blanks are cut off.
+     * A shorter text is closed with the RT end marker 0x0D, so the receiver knows
+     * it is complete and a 20 character title takes 6 instead of 16 2A groups.
+     */
+
+    uint8_t cps = rtB ? 2 : 4;              // Characters per segment, 2A has 4 in blocks C and D, 2B 2 in block D
+    uint8_t max = 16 * cps;
+    uint8_t len = 0;
+
+    while (len < max && rt[len] != '\0' && rt[len] != '\r') {len++;}   // Find the end of the text
+    while (len > 0 && rt[len-1] == ' ') {len--;}                       // Cut trailing blanks
+
+    rtSegN = (len == max) ? 16 : len / cps + 1;                        // Segments including the 0x0D end marker
+
+    for (uint8_t rtlc = 0; rtlc < rtSegN; rtlc++)                      // The letters only live in the images
+    {
+        uint8_t *txt = rtImg[rtlc] + 8 - cps;                          // Registers 0x14...0x17 or 0x16...0x17
+
+        for (uint8_t i = 0; i < cps; i++)
+        {
+            uint8_t p = rtlc * cps + i;
+            uint8_t c = (p < len) ? rt[p] : (p == len) ? 0x0D : ' ';   // Text, end marker, blanks
+            if (txt[i] != c) {txt[i] = c; bitSet(rtDirty, rtlc);}     // Remember changed segments
+        }
+    }
+
+    if (clrTXT != rdsAB) {rtDirty = 0xFFFF;}                           // New A/B state, all segments are new
+    rdsAB = clrTXT;
+    rtDirty = rtDirty & (uint16_t) ((1UL << rtSegN) - 1);              // Segments beyond the end are not sent
+
+    if (newPTY != rdsPTY) {rdsPTY = newPTY; encodePS_();}              // PTY is part of every group
+
+    encodeRT_();                                                       // Blocks A and B, PTY or A/B flag may have changed
+}
+
+void QN800x_TX::setRTmode(bool use2B, bool incremental) // Choose 2A (64) or 2B (32 characters), incremental updates
+{
+    /* In incremental mode a new text with unchanged A/B flag is sent by its changed
+     * segments only: startRDS_RT skips the others and the carousel sends changed
+     * segments first. Without it every RT sequence sends all segments of the text.
+     * Load the text again after switching between 2A and 2B.
+     */
+
+    if (use2B != rtB) {rtB = use2B; encodeRT_();}
+    rtIncr = incremental;
+}
+
+void QN800x_TX::encodeRT_() // Build blocks A and B (and C for 2B) of the RT group images
+{
+    uint16_t pty = rdsPTY << 5; // Move PTY bits to the correct position.
+
+    for (uint8_t rtlc = 0; rtlc < 16; rtlc++) // rtlc = Radio Text Letter Counter for RT quad letters
+    {
+        uint16_t rdsGrp_2A = 0b0010000000000000; // raw group 2A data. 2A offers 64 characters for RT
    
         /* Explanation for the 16 group 2A bits:
          * 0000->Group#, 1 = Bo -> B (0 = A), 0->TP, 00000->PTY, 0->T-A/B, xxxx-> RT letter counter 00...63 
          * 15-12         11                   10     9 - 5       4         3210    Bit number MSB....LSB
+         * Group 2B has bit 11 set, PI repeated in block C and two letters in block D only
          */
 
-        uint16_t pty = newPTY << 5; // Move PTY bits to the correct position.
+        if (rtB) {rdsGrp_2A = rdsGrp_2A | 0b0000100000000000;}   // 2B group
 
-        
-  
-        if (clrTXT) {rdsGrp_2A = rdsGrp_2A | 0b0000000000010000;} // Change A/B Text bit for new text 
+        if (rdsAB) {rdsGrp_2A = rdsGrp_2A | 0b0000000000010000;} // Change A/B Text bit for new text 
 
         rdsGrp_2A = rdsGrp_2A  + pty + rtlc; // Add Letter counter and PTY data to group
+        rdsGrp_2A = rdsGrp_2A | rdsFlags_(false); // TP
 
-      
-        buf[0] = RDS0;                             // First RDS register address 10h
-   	    buf[1] = rdsPI_h;                          // Send data for Register 0x10 PI High Byte
-        buf[2] = rdsPI_l;                          // Send data for Register 0x11 PI Low Byte
-        buf[3] = ((uint8_t) ((rdsGrp_2A) >> 8));   // Send data for Register 0x12 Group High Byte
-        buf[4] = ((uint8_t) ((rdsGrp_2A) & 0xff)); // Send data for Register 0x13 Group Low Byte
-        buf[5] = (rt[4*rtlc]);                     // Send data for Register 0x14 First letter
-        buf[6] = (rt[4*rtlc+1]);                   // Send data for Register 0x15 Second letter
-        buf[7] = (rt[4*rtlc+2]);                   // Send data for Register 0x16 Third letter
-        buf[8] = (rt[4*rtlc+3]);                   // Send data for Register 0x17 Fourth letter
-	  
-        SendData_(9);
-
-        rbuf[3] = rbuf[3] ^ 0b00000100;             // Toggle RDS Ready bit 
-   
-        buf[0] = SYSTEM1;                           // Register SYSTEM1 contains the RDSReady toggle bit
-        buf[1] = rbuf[3];                           // Send toggled bit to move RT data to RDS tx buffer
-	  
-        SendData_(2);
-
-        delay(100);                                  // Delay to allow the QN8007 to transmit the RDS data
+        uint8_t *img = rtImg[rtlc];
 
-        /* The RDS bit rate is 1187.5 kb/s. One full group of 4 blocks has a total of 104 bits
-         * 16 data bits + 10 bits for error correction hence 4 x 26 = 104 bits in a block.
-         * it takes 104b / 1187kb/s = 0.0877s i.e. ~90 ms of transmit time for a group to complete
-         * assuming a few ms of additional processing time at least 90 ms of delay needs to be 
-         * added for an ATMEGa328 running @16MHz.
-         */
+        img[0] = rdsPI_h;                          // Register 0x10 PI High Byte
+        img[1] = rdsPI_l;                          // Register 0x11 PI Low Byte
+        img[2] = ((uint8_t) ((rdsGrp_2A) >> 8));   // Register 0x12 Group High Byte
+        img[3] = ((uint8_t) ((rdsGrp_2A) & 0xff)); // Register 0x13 Group Low Byte
 
-        if (rtlc == 15){rttxC++;}// Increment PS completed transmission counter at the end of transmission cycle      
-        
+        if (rtB)
+        {
+        img[4] = rdsPI_h;                          // Register 0x14 PI High Byte repeat
+        img[5] = rdsPI_l;                          // Register 0x15 PI Low Byte repeat
         }
-
+    }
 }
 
 uint8_t QN800x_TX::getRTcomplete(bool reset)
@@ -472,3 +1087,520 @@ uint8_t QN800x_TX::getRTcomplete(bool reset)
      * sending a reset = true initializes the counter
      */
 
+
+//---------------------RDS Engine Section-----------------------------
+
+bool QN800x_TX::slotFree_(uint32_t now) // Check if the QN800x is ready for the next group
+{
+    if (rdsFree) return true;                                // Ready since an earlier call
+
+    /* The RDS bit rate is 1187.5 b/s. One full group of 4 blocks has a total of 104 bits
+     * 16 data bits + 10 bits for error correction hence 4 x 26 = 104 bits in a block.
+     * it takes 104b / 1187.5b/s = 87.579ms of transmit time for a group to complete.
+     * RDS_PACE_FIXED reserves 100 ms per group which wastes ~12% of the RDS channel.
+     * RDS_PACE_TIMER hands over a group exactly every 87.579 ms of host time.
+     * RDS_PACE_CHIP waits for the QN800x to toggle RDS_TXUPD after it fetched the
+     * last group, this follows the crystal of the QN800x and never races the chip.
+     * The chip can't be done before half a group after the load, from then on
+     * STATUS3 is read at most every RDS_POLL_US, so the bus stays nearly idle.
+     */
+
+    uint8_t st3;                                             // STATUS3 for RDS_PACE_CHIP
+
+    switch (rdsPace) 
+    {
+    case RDS_PACE_FIXED: 
+        if ((uint32_t) (now - rdsLastT) < RDS_GROUP_MS * 1000UL) return false;
+        rdsFreeT = rdsLastT + RDS_GROUP_MS * 1000UL;
+    break;
+    case RDS_PACE_TIMER:
+        if ((int32_t) (now - rdsFreeT) < 0) return false;    // rdsFreeT holds the deadline of the running slot
+    break;
+    case RDS_PACE_CHIP:
+        if ((uint32_t) (now - rdsLastT) < RDS_GROUP_US / 2) return false;   // Too early, no bus access
+        if ((uint32_t) (now - rdsPollT) < RDS_POLL_US) return false;       // Polled a moment ago
+        rdsPollT = now;
+        if (ReadRegs_(STATUS3, &st3, 1) == 1 && (bool) bitRead(st3, RDS_TXUPD) != rdsUpd) {rdsUpd = !rdsUpd;} // Group was fetched
+        else if ((uint32_t) (now - rdsLastT) >= 2 * RDS_GROUP_US) {rdsMissed++; STATS_ADD(missed, 1);} // No handshake, move on 
+        else return false;
+        rdsFreeT = now;
+    break;
+    }
+
+    rdsFree = true;
+    return true;
+}
+
+bool QN800x_TX::tick() // Non-blocking RDS engine, call it as often as possible from loop()
+{
+    uint32_t now = micros();
+
+    if (rdsMode == RDS_IDLE && !rdsPre && waitQ_(now) != 0) return false; // Nothing queued that may go out now
+
+    if (!slotFree_(now)) return false;                       // Time slot of the previous group not over yet
+    if (rdsMode == RDS_IDLE) rdsFreeT = now;                 // Host was idle, that is no missed slot
+
+    const uint8_t *img;
+    bool seq = false;                                        // Group of a PS or RT sequence
+    uint8_t qImg[8];                                         // Image of a queued group
+    int8_t q = -1;                                           // Queue entry sent in this slot
+
+    if (rdsPre)                                              // New flags first, PS groups carry TA and M/S as well
+    {
+        img = psImg[psSeg];
+        if (++psSeg == 4) {psSeg = 0; if (rdsMode == RDS_CAROUSEL) pstxC++;} // Full PS of the carousel sent, as in nextGroup_()
+        rdsPre = false;
+    }
+    else if ((q = pickQ_(now, true)) >= 0) {buildQ_(q, qImg); img = qImg;} // Deadline close, before any PS or RT group
+    else if (rdsMode == RDS_CAROUSEL) {img = nextGroup_(now, qImg, q);} // Endless weighted mix of PS, RT and queued groups
+    else if (rdsMode == RDS_IDLE)                            // No sequence, only queued groups, e.g. clock time alone
+    {
+        if ((q = pickQ_(now, false)) < 0) return false;     // Dropped, too late
+        buildQ_(q, qImg);
+        img = qImg;
+    }
+    else
+    {
+        if (rdsMode == RDS_RT) {while (rdsGrpC < 16 && !bitRead(rtSeqMask, rdsGrpC)) rdsGrpC++;} // Skip unused segments
+
+        uint8_t groups = (rdsMode == RDS_PS) ? 4 : 16;      // Number of groups in the running sequence
+
+        if (rdsGrpC == groups)                               // Slot of the last group is over, sequence is complete
+        {
+            if (rdsMode == RDS_PS) {pstxC++;}                // Increase PS completed transmission counter
+            if (rdsMode == RDS_RT) {rttxC++;}                // Increase RT completed transmission counter
+            rdsMode = RDS_IDLE;
+            return false;
+        }
+
+        img = (rdsMode == RDS_PS) ? psImg[rdsGrpC] : rtImg[rdsGrpC];
+        seq = true;
+    }
+
+    bool sent = SendBurst_(RDS0, img, 8);                    // Load RDS0...RDS7 with the next group
+
+    if (sent)
+    {
+        shadow[SYSTEM1] = shadow[SYSTEM1] ^ 0b00000100;     // Toggle RDS Ready bit to move data to QN8007 RDS tx data buffer
+        sent = sendReg_(SYSTEM1);                            // At once, even inside beginUpdate()/commitUpdate()
+        if (!sent) shadow[SYSTEM1] = shadow[SYSTEM1] ^ 0b00000100; // The QN800x never saw the toggle
+    }
+
+    if (!sent) return false;                                 // Bus failed for good, the slot stays free for the next try
+
+    if (seq)                                                 // Sequence moves on only once the group is loaded
+    {
+        if (rdsMode == RDS_RT) bitClear(rtDirty, rdsGrpC);
+        rdsGrpC++;
+    }
+
+    if (q >= 0)                                              // Queued group is on its way
+    {
+        if (rdsQ[q].grp == RDS_GRP_4A) {ctLate = now - rdsQ[q].from;} // On air one slot later, from is one slot before the minute
+        rdsQ[q].grp = RDS_Q_FREE;
+    }
+
+    uint32_t late = now - rdsFreeT;                          // Time the QN800x was waiting for this group
+
+    if (late >= RDS_GROUP_US) {rdsMissed += late / RDS_GROUP_US; STATS_ADD(missed, late / RDS_GROUP_US);} // The QN800x repeated old data meanwhile
+
+    if (rdsPace == RDS_PACE_TIMER)                           // Deadline for the next group
+    {
+        if (late >= RDS_GROUP_US) {rdsFreeT = now + RDS_GROUP_US;} // Start a new time base after a miss
+        else {rdsFreeT = rdsFreeT + RDS_GROUP_US;}                  // Keep the time base, no drift
+    }
+
+    rdsLastT = now;                                          // Start of the time slot for this group
+    rdsFree = false;
+
+#if QN800X_STATS
+    stats.groups[img[2] >> 3]++;                             // Group type and version from block B
+    if (late > STATS_LATE_US) stats.late++;
+    if (late > stats.lateMaxUs) stats.lateMaxUs = late;
+
+    uint32_t took = micros() - now;                          // Host time for this group
+    if (took < stats.grpMinUs) stats.grpMinUs = took;
+    if (took > stats.grpMaxUs) stats.grpMaxUs = took;
+#endif
+
+    return true;
+}
+
+uint32_t QN800x_TX::nextTick() // Time in µs until tick() has work, 0 = call tick() now
+{
+    return rdsWait_();
+}
+
+uint32_t QN800x_TX::rdsWait_() // Time in µs until tick() has work, for QN800x_Fleet
+{
+    uint32_t now = micros();
+    uint32_t qw = 0;                                         // Engine idle: until a queued group may go out
+
+    if (rdsMode == RDS_IDLE && !rdsPre)
+    {
+        qw = waitQ_(now);
+        if (qw == 0xFFFFFFFFUL) return qw;                   // Nothing queued
+    }
+
+    if (rdsFree) return qw;
+
+    uint32_t due;
+
+    switch (rdsPace) 
+    {
+    case RDS_PACE_FIXED: due = rdsLastT + RDS_GROUP_MS * 1000UL; break;
+    case RDS_PACE_TIMER: due = rdsFreeT; break;
+    default:                                                 // Start polling RDS_TXUPD half a group after the load
+        due = rdsLastT + RDS_GROUP_US / 2;
+        if ((int32_t) (rdsPollT + RDS_POLL_US - due) > 0) due = rdsPollT + RDS_POLL_US; // Then every RDS_POLL_US
+    break;
+    }
+
+    uint32_t w = ((int32_t) (due - now) > 0) ? due - now : 0;
+    return (w > qw) ? w : qw;
+}
+
+void QN800x_TX::shiftRDS_(uint32_t offset) // Move the next group slot offset µs from now, for QN800x_Fleet
+{
+    uint32_t now = micros();
+
+    rdsFree = false;
+    rdsFreeT = now + offset;
+    rdsLastT = now + offset - ((rdsPace == RDS_PACE_FIXED) ? RDS_GROUP_MS * 1000UL : RDS_GROUP_US);
+}
+
+bool QN800x_TX::rdsBusy() // Check if a PS or RT sequence is still being sent
+{
+    return rdsMode != RDS_IDLE;
+}
+
+void QN800x_TX::setRDSpacing(uint8_t pace) // Choose how the RDS engine paces the groups
+{
+    if (pace > RDS_PACE_CHIP) pace = RDS_PACE_TIMER;        // Default for invalid input
+
+    if (pace == RDS_PACE_CHIP) {rdsUpd = bitRead(ReadReg_(STATUS3), RDS_TXUPD);} // Start from the current handshake state
+
+    rdsPace = pace;
+}
+
+uint16_t QN800x_TX::getRDSmissed(bool reset) // Get missed group slot counter value, look for counter reset
+{
+    if (reset) {rdsMissed = 0;}                // Reset missed slot counter to 0 when reset is true
+    return rdsMissed;                          // Send current value of the counter to main program
+}
+
+//---------------------RDS Carousel Section---------------------------
+
+/* In carousel mode the RDS engine never stops. Each time slot gets a single group,
+ * PS and RT segments are interleaved by weight instead of sending whole 4 group PS
+ * and 16 group RT sequences back to back. A receiver tuning in sees the station name
+ * after 4 PS slots rather than after a complete RT sequence.
+ */
+
+void QN800x_TX::setRDSweights(uint8_t psW, uint8_t rtW, uint8_t otherW) // Share of the group slots per group type
+{
+    if (psW == 0 && rtW == 0) psW = 1;      // At least one of PS and RT has to be sent
+
+    rdsW[0] = psW;
+    rdsW[1] = rtW;
+    rdsW[2] = otherW;                       // Queued groups without close deadline, only counted while one is waiting
+
+    rdsCr[0] = 0; rdsCr[1] = 0; rdsCr[2] = 0;
+}
+
+void QN800x_TX::startCarousel() // Send PS and RT groups endlessly, mixed by weight
+{
+    getReg_(SYSTEM1);                       // Make sure the current state of the RDS ready bit is known
+
+    if (rdsMode == RDS_IDLE && rdsFree) {rdsFreeT = micros();} // Host was idle, that is no missed slot
+
+    if (rdsCap) rdsMode = RDS_CAROUSEL;     // Replaces a PS or RT sequence that may still be running
+}
+
+void QN800x_TX::stopRDS() // Stop the carousel or a running sequence, the QN800x repeats the last group
+{
+    rdsMode = RDS_IDLE;
+}
+
+void QN800x_TX::rushRT() // Next carousel slot carries the first segment of the RT
+{
+    /* Called after loadRDS_RT with a new title. The RT restarts at segment 0 and
+     * credit moves from PS to RT until RT wins the next slot. The sum of the credits
+     * stays the same, PS gets its slots back over the following groups and the
+     * share of the weights is kept.
+     */
+
+    if (rdsW[1] == 0) return;                                     // RT is not part of the carousel
+
+    rtSeg = 0;
+    int16_t need = (rdsW[0] - rdsW[1]) - (rdsCr[1] - rdsCr[0]);   // RT wins when its lead beats this
+    if (need >= 0)
+    {
+        int16_t d = need / 2 + 1;
+        rdsCr[0] -= d;
+        rdsCr[1] += d;
+    }
+}
+
+const uint8_t *QN800x_TX::nextGroup_(uint32_t now, uint8_t *qImg, int8_t &q) // Pick the next carousel group
+{
+    /* Smooth weighted round robin: every slot each group type earns its weight as
+     * credit, the type with most credit is sent and pays back the sum of all weights.
+     * Weights 40:15 give P P R P P R P P P R ... spread evenly over the slots.
+     * Queued groups take part with the third weight while one of them may go out.
+     */
+
+    int8_t ready = (rdsW[2] > 0) ? pickQ_(now, false) : -1;
+    int16_t total = rdsW[0] + rdsW[1];
+
+    rdsCr[0] += rdsW[0];
+    rdsCr[1] += rdsW[1];
+    if (ready >= 0) {rdsCr[2] += rdsW[2]; total += rdsW[2];}
+
+    uint8_t k = (rdsW[0] > 0) ? 0 : 1;                            // PS wins ties
+    if (rdsW[1] > 0 && rdsCr[1] > rdsCr[k]) k = 1;
+    if (ready >= 0 && rdsCr[2] > rdsCr[k]) k = 2;
+
+    rdsCr[k] -= total;
+
+    if (k == 2)                                                   // Queued group
+    {
+        q = ready;
+        buildQ_(q, qImg);
+        return qImg;
+    }
+
+    if (k == 0)                                                   // PS group
+    {
+        const uint8_t *img = psImg[psSeg];
+        if (++psSeg == 4) {psSeg = 0; pstxC++;}                   // Full PS sent
+        return img;
+    }
+
+    if (rtSeg >= rtSegN) {rtSeg = 0;}                             // Text got shorter
+
+    uint8_t seg = rtSeg;
+
+    if (rtIncr && rtDirty)                                        // Changed segments first
+    {
+        for (seg = 0; !bitRead(rtDirty, seg); seg++) {}
+    }
+    else if (++rtSeg == rtSegN) {rtSeg = 0; rttxC++;}             // Full RT sent
+
+    bitClear(rtDirty, seg);
+    return rtImg[seg];
+}
+
+uint16_t QN800x_TX::getPSready() // Worst case time in ms a receiver needs for the complete PS in carousel mode
+{
+    return readyTime_(4, rdsW[0]);
+}
+
+uint16_t QN800x_TX::getRTready() // Worst case time in ms a receiver needs for the complete RT in carousel mode
+{
+    return readyTime_(rtSegN, rdsW[1]);
+}
+
+uint16_t QN800x_TX::readyTime_(uint8_t segs, uint8_t weight) // Time for segs groups of one type at its share of slots
+{
+    if (weight == 0) return 0xFFFF;                               // Never complete
+
+    uint32_t total = rdsW[0] + rdsW[1];
+    uint32_t slots = (segs * total + weight - 1) / weight + 1;    // Slots for all segments, +1 for tuning in mid slot
+    uint32_t slot = (rdsPace == RDS_PACE_FIXED) ? RDS_GROUP_MS * 1000UL : RDS_GROUP_US;
+
+    return (slots * slot) / 1000;
+}
+
+//---------------------RDS Queue Section---------------------------
+
+/* Groups that have to go out at a certain time, like the 4A clock time, do not
+ * wait for their turn in the carousel or behind a running sequence. Each queued
+ * group has a priority and a time window from...due. Once its deadline is less than
+ * RDS_URGENT_US away it takes the next free slot, before PS and RT. Until then it
+ * is sent with the third carousel weight, if that is not 0. A group that missed
+ * its deadline is dropped and counted.
+ */
+
+bool QN800x_TX::queueGroup(uint8_t grp, uint8_t b, uint16_t c, uint16_t d, uint8_t prio, uint32_t from, uint32_t due) // Send a group between from and due
+{
+    if (grp > 31 || !rdsCap) return false;
+
+    for (uint8_t i = 0; i < RDS_QUEUE; i++)
+    {
+        QN800x_Group &g = rdsQ[i];
+        if (g.grp != RDS_Q_FREE) continue;
+
+        g.grp = grp;
+        g.prio = prio;
+        g.b = b & 0x1F;
+        g.c = c;
+        g.d = d;
+        g.from = from;
+        g.due = due;
+        return true;
+    }
+
+    return false;                            // Queue full
+}
+
+uint32_t QN800x_TX::waitQ_(uint32_t now) // Time until the earliest queued group may go out
+{
+    uint32_t w = 0xFFFFFFFFUL;
+
+    for (uint8_t i = 0; i < RDS_QUEUE; i++)
+    {
+        QN800x_Group &g = rdsQ[i];
+
+        if (g.grp == RDS_Q_FREE) continue;
+        if ((int32_t) (g.from - now) <= 0) return 0;        // May go now, or is too late and gets dropped by pickQ_()
+        if (g.from - now < w) w = g.from - now;
+    }
+
+    return w;
+}
+
+int8_t QN800x_TX::pickQ_(uint32_t now, bool urgent) // Queued group that may go out now, highest priority, then earliest deadline
+{
+    int8_t best = -1;
+
+    for (uint8_t i = 0; i < RDS_QUEUE; i++)
+    {
+        QN800x_Group &g = rdsQ[i];
+
+        if (g.grp == RDS_Q_FREE) continue;
+        if ((int32_t) (now - g.due) > 0) {g.grp = RDS_Q_FREE; rdsDropped++; continue;} // Too late, e.g. time of a past minute
+        if ((int32_t) (now - g.from) < 0) continue;                                  // Not yet
+        if (urgent && (uint32_t) (g.due - now) >= RDS_URGENT_US) continue;           // Can wait for its share
+
+        if (best < 0 || g.prio > rdsQ[best].prio || (g.prio == rdsQ[best].prio && (int32_t) (g.due - rdsQ[best].due) < 0)) best = i;
+    }
+
+    return best;
+}
+
+void QN800x_TX::buildQ_(uint8_t i, uint8_t *img) // Blocks A...D of a queued group, with the current PI, PTY and TP
+{
+    const QN800x_Group &g = rdsQ[i];
+
+    uint16_t b = ((uint16_t) g.grp << 11) | rdsFlags_(false) | (rdsPTY << 5) | g.b;
+    uint16_t c = (g.grp & 1) ? (rdsPI_h << 8) | rdsPI_l : g.c;      // B groups repeat the PI in block C
+
+    img[0] = rdsPI_h;
+    img[1] = rdsPI_l;
+    img[2] = b >> 8;
+    img[3] = b & 0xFF;
+    img[4] = c >> 8;
+    img[5] = c & 0xFF;
+    img[6] = g.d >> 8;
+    img[7] = g.d & 0xFF;
+}
+
+bool QN800x_TX::setClock(uint32_t mjd, uint8_t hour, uint8_t minute, int8_t offset, uint32_t at) // Queue a 4A clock time group
+{
+    /* mjd, hour and minute are UTC, offset is local time - UTC in half hours, at is
+     * the micros() time the minute starts. A group handed over goes on air at the
+     * next group boundary of the QN800x, so the group is handed over in the last slot
+     * before the minute and starts on air within one group after the minute edge.
+     * It is dropped if no slot was free in that window (plus RDS_CT_SLACK_US host
+     * jitter). getCTlate() gives the worst case start on air after the minute edge.
+     *
+     * Block B: MJD bits 16...15, block C: MJD bits 14...0 and hour bit 4,
+     * block D: hour bits 3...0, minute, sign and size of the offset.
+     */
+
+    if (mjd > 0x1FFFFUL || hour > 23 || minute > 59 || offset < -24 || offset > 24) return false;
+
+    for (uint8_t i = 0; i < RDS_QUEUE; i++)                         // Only the latest time is of any use
+    {
+        if (rdsQ[i].grp == RDS_GRP_4A) rdsQ[i].grp = RDS_Q_FREE;
+    }
+
+    uint16_t c = (uint16_t) ((mjd & 0x7FFF) << 1) | (hour >> 4);
+    uint16_t d = ((uint16_t) (hour & 0x0F) << 12) | ((uint16_t) minute << 6) | ((offset < 0) ? 0x20 | -offset : offset);
+
+    uint32_t slot = (rdsPace == RDS_PACE_FIXED) ? RDS_GROUP_MS * 1000UL : RDS_GROUP_US;
+
+    return queueGroup(RDS_GRP_4A, mjd >> 15, c, d, RDS_PRIO_CT, at - slot, at + RDS_CT_SLACK_US);
+}
+
+uint32_t QN800x_TX::toMJD(uint16_t year, uint8_t month, uint8_t day) // Modified Julian Date, IEC 62106 Annex G
+{
+    uint8_t l = (month <= 2) ? 1 : 0;
+
+    return 14956UL + day + ((uint32_t) (year - 1900 - l) * 1461) / 4 + ((uint32_t) (month + 1 + l * 12) * 306001UL) / 10000;
+}
+
+uint32_t QN800x_TX::getCTlate() // Start on air of the last 4A group after its minute edge, 0xFFFFFFFF = none sent yet
+{
+    return ctLate;
+}
+
+uint16_t QN800x_TX::getRDSdropped(bool reset) // Get dropped group counter value, look for counter reset
+{
+    uint16_t n = rdsDropped;
+    if (reset) {rdsDropped = 0;}
+    return n;
+}
+
+#else
+
+bool QN800x_TX::tick() // Built without RDS, nothing to do
+{
+    return false;
+}
+
+uint32_t QN800x_TX::nextTick()
+{
+    return 0xFFFFFFFFUL;
+}
+
+uint32_t QN800x_TX::rdsWait_()
+{
+    return 0xFFFFFFFFUL;
+}
+
+#endif
+
+//---------------------Instrumentation Section-----------------------------
+
+#if QN800X_STATS
+
+const QN800x_Stats &QN800x_TX::getStats() // Counters since power up or the last resetStats()
+{
+    return stats;
+}
+
+void QN800x_TX::resetStats()
+{
+    memset(&stats, 0, sizeof(stats));
+    waitRest = 0;
+#if QN800X_RDS
+    stats.grpMinUs = 0xFFFFFFFFUL;      // No group yet
+#endif
+}
+
+uint8_t QN800x_TX::statsIdx_(uint8_t reg) // 0x00...0x1B direct, then REG_XLT3, PAG_CAL and all others
+{
+    if (reg <= STATUS3) return reg;
+    if (reg == REG_XLT3) return STATUS3 + 1;
+    if (reg == PAG_CAL) return STATUS3 + 2;
+    return STATS_REGS - 1;
+}
+
+void QN800x_TX::countIO_(uint8_t reg, uint8_t len, bool rd, uint8_t status)
+{
+    if (rd) {stats.reads++; stats.bytesRead += len;}
+    else {stats.writes++;}
+
+    if (status == 2) {stats.nackAddr++; return;}            // Nothing reached the registers
+    if (status == 3) {stats.nackData++;}
+    else if (status != 0) {stats.busErrors++;}
+
+    if (rd) {for (uint8_t i = 0; i < len; i++) stats.regRead[statsIdx_(reg + i)]++; return;}
+
+    stats.bytesWritten += len;
+    for (uint8_t i = 0; i < len; i++) stats.regWritten[statsIdx_(reg + i)]++; // Auto-increment
+}
+
+#endif
@@ -28,7 +28,8 @@ Author: Semir Nouri, December 2024
 
 */
 
-#include <Wire.h>
+#include <QN800x_Config.h>
+#include <QN800x_Bus.h>
 
 #ifndef QN800x_TX_h
 #define QN800x_TX_h
@@ -37,6 +38,8 @@ Author: Semir Nouri, December 2024
 #define SYSTEM1    0x01        /* Sets device modes, resets                           */
 #define ANACTL1    0x03        /* Analog control functions                            */
 #define REG_VGA    0x04        /* TX mode input impedance, crystal cap load setting   */
+#define CID1       0x05        /* Chip ID: product family, minor revision             */
+#define CID2       0x06        /* Chip ID: product ID (bits 7:2), major revision      */
 #define IIS        0x07        /* Sets I2S parameters                                 */
 #define CH         0x08        /* Lower 8 bits of 10-bit channel index                */
 #define CH_STEP    0x0B        /* Channel scan frequency step. Highest 2 bits of channel indexes. */
@@ -51,19 +54,175 @@ Author: Semir Nouri, December 2024
 #define RDS6       0x16        /* RDS data byte 6                                     */
 #define RDS7       0x17        /* RDS data byte 7                                     */
 #define RDSFDEV    0x18        /* Specify RDS frequency deviation, RDS mode selection */
+#define STATUS3    0x1B        /* RDS status, RDS_TXUPD toggles when a group was fetched */
 #define REG_XLT3   0x49        /* XCLK pin control                                    */
 #define PAG_CAL    0x5A        /* PA gain calibration                                 */
 
+#define SH_LEN     27          /* Number of shadow registers: 0x00...0x18, REG_XLT3, PAG_CAL */
+#define SH_XLT3    25          /* Shadow index of REG_XLT3                            */
+#define SH_PAG_CAL 26          /* Shadow index of PAG_CAL                             */
+#define SH_ALL     0x0700CF9BUL /* Writable setup registers 0x00, 0x01, 0x03, 0x04, 0x07...0x0B, 0x0E, 0x0F, 0x18, REG_XLT3, PAG_CAL */
+#define SH_BRIDGE  0x0100CF98UL /* Registers that may be rewritten to join two bursts */
+#define SH_GAP     2           /* Longest gap of clean registers bridged in a burst    */
+
+#define RDS_GROUP_MS 100       /* Time slot reserved for the transmission of one RDS group (ms) */
+#define RDS_GROUP_US 87579     /* Exact air time of one RDS group: 104 bits / 1187.5 bit/s (µs) */
+#define RDS_TXUPD  7           /* Bit in STATUS3 toggled by the QN800x each time it fetched RDS0...RDS7 */
+#define RDS_POLL_US 4000       /* RDS_PACE_CHIP: shortest time between two reads of STATUS3 (µs) */
+
+#define RDS_PACE_FIXED 0       /* Hand over one group every RDS_GROUP_MS, as in earlier versions */
+#define RDS_PACE_TIMER 1       /* Hand over one group every RDS_GROUP_US, host timer paced        */
+#define RDS_PACE_CHIP  2       /* Hand over the next group as soon as the QN800x took the last one */
+
+#define RDS_IDLE   0           /* RDS engine state: nothing queued                    */
+#define RDS_PS     1           /* RDS engine state: PS sequence (4 groups) running    */
+#define RDS_RT     2           /* RDS engine state: RT sequence (up to 16 groups) running */
+#define RDS_CAROUSEL 3         /* RDS engine state: PS and RT groups mixed by weight  */
+#define RDS_FLAGS_0 0x0418     /* Block B bits TP, TA and M/S of group 0A/0B           */
+#define RDS_QUEUE  4           /* Queued groups with deadline, e.g. 4A clock time     */
+#define RDS_Q_FREE 0xFF        /* Unused queue entry                                  */
+#define RDS_URGENT_US (2UL * RDS_GROUP_US) /* A queued group this close to its deadline takes the next slot */
+#define RDS_GRP_4A 8           /* Group index type * 2 + B of clock time 4A           */
+#define RDS_PRIO_CT 255        /* Queue priority of clock time                        */
+#define RDS_CT_SLACK_US 10000  /* Host jitter allowed on top of one group slot for clock time (µs) */
+
+#define BUS_RETRIES 3         /* Repeats of a failed I2C transaction before the bus is recovered */
+#define BUS_BACKOFF_US 200     /* Pause before the first repeat, doubled for each further one (µs) */
+
+#define FREQ_MIN   760         /* Lowest frequency, 76.0 MHz                          */
+#define FREQ_MAX   1080        /* Highest frequency, 108.0 MHz                        */
+#define CH_MAX     640         /* Channel index of FREQ_MAX                           */
+#define HOP_SETTLE_US 2000     /* Muted time for the PLL to settle after a hop (µs)   */
+
+/* 10-bit channel index of a frequency in 100 kHz units, e.g. QN800X_CHANNEL(977) for
+ * 97.7 MHz. Constant input gives a constant, a table of site channels costs no code.
+ */
+#define QN800X_CHANNEL(f) ((uint16_t) (((uint32_t) (f) * 10 - 7600) / 5))
+
+/* Register values of the simple setters, constant for constant arguments. The
+ * setters use them too, with link time optimisation (Arduino AVR default) a call
+ * with constants stores a ready value.
+ */
+#define QN800X_VGA(xtune, imp) ((uint8_t) (((imp) << 6) | ((xtune) & 0x3F))) /* REG_VGA, tuneXtal_Rin()  */
+#define QN800X_PAG(power)      ((uint8_t) (0x40 | ((power) & 0x0F)))         /* PAG_CAL, setPower()       */
+#define QN800X_RDSDEV(dev)     ((uint8_t) (0x80 | ((dev) & 0x7F)))           /* RDSFDEV, setDevRDS()      */
+
+#define I2S_FMT_I2S   0        /* IIS bits 2:1: Philips I2S, data one BCK after the WCK edge */
+#define I2S_FMT_LEFT  1        /* Left justified, data at the WCK edge                */
+#define I2S_FMT_RIGHT 2        /* Right justified, data ends at the WCK edge          */
+#define I2S_FMT_DSP   3        /* DSP/PCM, short frame pulse on WCK                   */
+
+#define CID_QN800X  0x0D       /* CID2 product ID of QN8006 and QN8007, both have the same */
+#define CID_QN800XL 0x0E       /* CID2 product ID of the "L" parts without RDS        */
+#define CHIP_NONE    0         /* No QN800x answered                                  */
+#define CHIP_QN800X  1         /* QN8006 or QN8007 with RDS                           */
+#define CHIP_QN800XL 2         /* QN8006L or QN8007L, RDS engine disabled             */
+#define CHIP_UNKNOWN 3         /* Unknown product ID, RDS left enabled                */
+#define BEGIN_TIMEOUT_MS 500   /* Longest wait for the QN800x after reset, the former blind delay */
+#define BEGIN_POLL_US 500      /* Poll interval while waiting for the QN800x          */
+
+struct QN800x_Setup
+{
+    bool extClk;                        // External clock on pin 16 instead of the crystal
+    uint8_t xtune;                      // Crystal load 0...61, see tuneXtal_Rin()
+    uint8_t impedance;                  // Input impedance 0...3 = 10k, 20k, 40k, 80k
+    uint8_t deviation;                  // Multiplex deviation, 108 = 75 kHz
+    uint8_t devPilot;                   // Pilot deviation 7...10 %
+    uint8_t devRDS;                     // RDS deviation 0...127
+    uint8_t power;                      // RF power 0...15, 0xFF = leave the power up setting
+    bool stereo;                        // Stereo or mono
+    bool I2S;                           // Digital I2S or analog input
+    bool RDS;                           // RDS on, ignored on "L" parts
+    uint16_t frequency;                 // 760...1080 = 76.0...108.0 MHz
+    bool i2sMaster;                     // QN800x drives BCK and WCK, false = the host does, see setI2S()
+    uint8_t i2sRate;                    // 32, 40, 44 (44.1) or 48 kHz, 0 = leave the power up setting
+    uint8_t i2sBits;                    // Word length 8 or 16
+    uint8_t i2sFormat;                  // I2S_FMT_I2S, I2S_FMT_LEFT, I2S_FMT_RIGHT or I2S_FMT_DSP
+
+    QN800x_Setup() : extClk(false), xtune(1), impedance(2), deviation(108), devPilot(9), devRDS(8),
+                     power(0xFF), stereo(true), I2S(false), RDS(true), frequency(977),
+                     i2sMaster(true), i2sRate(0), i2sBits(16), i2sFormat(I2S_FMT_I2S) {}
+};
+
+struct QN800x_Group
+{
+    uint8_t grp;                        // Type * 2 + B, e.g. RDS_GRP_4A, RDS_Q_FREE = unused
+    uint8_t prio;                       // Higher goes first
+    uint8_t b;                          // Block B bits 4...0
+    uint16_t c;                         // Block C, the PI code for B groups
+    uint16_t d;                         // Block D
+    uint32_t from;                      // micros() time the group may go out
+    uint32_t due;                       // micros() deadline, dropped when missed
+};
+
+struct QN800x_Snapshot
+{
+    uint8_t regs[SH_LEN];               // Shadow registers, see shIdx_()
+    uint32_t valid;                     // Registers present in regs[]
+};
+
+#define STATS_REGS 31          /* Per register counters: 0x00...0x1B, REG_XLT3, PAG_CAL, others */
+#define STATS_LATE_US 5000     /* A group handed over later than this after its slot is counted late */
+
+#if QN800X_STATS
+
+struct QN800x_Stats
+{
+    uint32_t writes;                    // I2C write transactions
+    uint32_t reads;                     // I2C read transactions
+    uint32_t bytesWritten;              // Data bytes written, without sub addresses
+    uint32_t bytesRead;                 // Data bytes read
+    uint32_t regWritten[STATS_REGS];    // Bytes written per register, see statsIdx_()
+    uint32_t regRead[STATS_REGS];       // Bytes read per register
+    uint32_t nackAddr;                  // Writes the QN800x did not acknowledge its address for
+    uint32_t nackData;                  // Writes with a data byte not acknowledged
+    uint32_t busErrors;                 // Other write errors and short reads
+    uint32_t retries;                   // Transactions repeated after an error
+    uint32_t recoveries;                // Hung bus clocked free and setup written again
+    uint32_t failed;                    // Transactions given up after retries and recovery
+    uint32_t delayMs;                   // Time the library blocked the caller: delays, bus backoff, blocking RDS calls
+#if QN800X_RDS
+    uint32_t groups[32];                // Groups sent by type, index = type * 2 + B, e.g. [0] = 0A, [5] = 2B
+    uint32_t missed;                    // Group slots that passed without new data
+    uint32_t late;                      // Groups handed over more than STATS_LATE_US after the slot was free
+    uint32_t lateMaxUs;                 // Longest delay between a free slot and its group
+    uint32_t grpMinUs;                  // Shortest host time to pick and load one group
+    uint32_t grpMaxUs;                  // Longest host time to pick and load one group
+#endif
+};
+
+#endif
+
 class QN800x_TX
 {
 
+friend class QN800x_Fleet;             // Interleaves the group slots and broadcasts setups of several QN800x
+friend class QN800x_Task;              // Sleeps until the next group slot
+
 public:
   
-    QN800x_TX();
+#ifdef ARDUINO
+    QN800x_TX();                                            // QN800x on Wire
+#endif
+    QN800x_TX(QN800x_Bus &bus, uint8_t address = 0x2B);     // QN800x on any transport, see QN800x_Bus.h
   
     void swReset(bool reset); // Reset the QN8007 via software
     void bbReset(uint8_t gap); // Reset the QN8007 audio Base Band (and it seems RDS) registers
+    bool resync();             // Read all setup registers from the QN800x into the shadow copy
+    void beginUpdate();        // Collect the following register changes...
+    bool commitUpdate();       // ...and write them in a minimum of I2C bursts, false if a write failed
+    uint8_t getBusError(bool reset); // Error of the last transaction that failed for good: 2 = address NACK, 3 = data NACK, 4 = other
     
+    // Start up
+
+    bool begin(const QN800x_Setup &setup);    // Reset, wait for the QN800x, detect the chip, write the setup in a few bursts
+    bool begin(const QN800x_Snapshot &snap);  // Warm restart: wait for the QN800x and write a saved snapshot, no reset
+    void saveSnapshot(QN800x_Snapshot &snap); // Save all known setup registers, e.g. to EEPROM or RTC RAM
+    uint8_t getChip();                        // CHIP_NONE, CHIP_QN800X, CHIP_QN800XL or CHIP_UNKNOWN
+    uint8_t getChipID();                      // Raw CID2 register as read by begin()
+    bool hasRDS();                            // False on "L" parts or with QN800X_RDS 0, the RDS engine stays idle
+    uint32_t getStartupTime();                // Time in µs the last begin() took until the setup was written
+
     // General setup
 
     void setExtClk(bool ext);                            // Choose external clock source by setting to true
@@ -74,7 +233,8 @@ public:
     // RF Setup
 
     void initTransmit(bool stereo, bool I2S, bool RDS);  // Innitial transmitter settings
-    void setFrequency(uint16_t frequency);               // Range from 760-1080 equals 76MHz - 108MHz
+    bool setFrequency(uint16_t frequency);               // Range from 760-1080 equals 76MHz - 108MHz, false if out of range
+    uint32_t hopChannel(uint16_t ch, bool mute);         // Retune to QN800X_CHANNEL() index in one burst, muted if wanted, returns µs
     void setPower(uint8_t power);                        // Range from 0-15 equals 124-101.5 dBµV
 
     void setDeviation(uint8_t totaldev);                 // Range from 0-255 default is 108
@@ -84,27 +244,165 @@ public:
     // Audio Setup
 
     void setMute(bool mute);           // Mute the audio. 
+#if QN800X_I2S
     void setDAsrate(uint8_t samprate); // Set Audio sample rate in QN8007 Master mode: 32, 40, 44.1, 48
+    bool setI2S(bool master, uint8_t rate, uint8_t bits, uint8_t format); // Master or slave, 32/40/44/48 kHz, 8 or 16 bit, I2S_FMT_..., false if not supported
+#endif
 
+#if QN800X_RDS
     // RDS Setup
  
     void setRDS_PS (char ps[], uint16_t newPTY, bool useB0, bool stereo);   // Send your PS and PTY, chose group B0 or A0 for PS
     void setRDS_RT (char rt[], uint16_t newPTY, bool clrTXT);  // Send your Radio Text
 
+    void loadRDS_PS (char ps[], uint16_t newPTY, bool useB0, bool stereo);  // Only update the PS group cache
+    void loadRDS_RT (char rt[], uint16_t newPTY, bool clrTXT); // Only update the RT group cache
+    void setRTmode (bool use2B, bool incremental);          // RT in 2A (64) or 2B (32 characters) groups, send changes only
+    uint32_t setRDSflags (uint16_t newPTY, bool tp, bool ta, bool ms); // Change PTY, TP, TA, M/S with the next group, returns µs
+    void setRDS_PI (uint16_t pi);      // Set the PI code, default 0xD022
+    void setRDS_AF (uint8_t af[]);     // Set the 8 byte AF list for 0A groups, first byte 224 + number of AFs
+
+    // Non-blocking RDS engine
+
+    void startRDS_PS (char ps[], uint16_t newPTY, bool useB0, bool stereo); // Queue one PS sequence and return at once
+    void startRDS_RT (char rt[], uint16_t newPTY, bool clrTXT);             // Queue one RT sequence and return at once
+    void startRDSflags (uint16_t newPTY, bool tp, bool ta, bool ms);       // New PTY, TP, TA, M/S in the next group slot, return at once
+#endif
+    bool tick();                       // Call from loop(), loads the next RDS group when its time slot has elapsed
+    uint32_t nextTick();               // Time in µs until tick() has work, 0xFFFFFFFF = nothing queued, for event loops that sleep
+#if QN800X_RDS
+    bool rdsBusy();                    // True as long as a queued PS or RT sequence has not been completed
+    void setRDSpacing(uint8_t pace);   // RDS_PACE_FIXED, RDS_PACE_TIMER (default) or RDS_PACE_CHIP
+    uint16_t getRDSmissed(bool reset); // Get the number of group slots the host was too late for, reset counter
+
+    // RDS carousel
+
+    void setRDSweights(uint8_t psW, uint8_t rtW, uint8_t otherW); // Share of group slots for PS, RT and other groups
+    void startCarousel();              // Send PS and RT groups endlessly, one group per slot mixed by weight
+    void stopRDS();                    // Stop the carousel or a running sequence
+    void rushRT();                     // Next carousel slot carries the first segment of the RT
+    uint16_t getPSready();             // Time in ms until a receiver that just tuned in has the complete PS
+    uint16_t getRTready();             // Time in ms until a receiver that just tuned in has the complete RT
     
     uint8_t getPScomplete(bool reset); // Get the number of PS transmissions in a sequnence, reset counter
     uint8_t getRTcomplete(bool reset); // Get the number of RT transmissions in a sequnence, reset counter
+
+    // Time critical groups, sent while a sequence or the carousel runs
+
+    bool queueGroup(uint8_t grp, uint8_t b, uint16_t c, uint16_t d, uint8_t prio, uint32_t from, uint32_t due); // Send a group between micros() times from and due, false if the queue is full
+    bool setClock(uint32_t mjd, uint8_t hour, uint8_t minute, int8_t offset, uint32_t at); // Clock time 4A: UTC, local offset in half hours, micros() time the minute starts
+    static uint32_t toMJD(uint16_t year, uint8_t month, uint8_t day); // Modified Julian Date of a date, 1900-03-01...2100-02-28
+    uint32_t getCTlate();              // Time in µs from the start of the minute until the last 4A group went on air, worst case
+    uint16_t getRDSdropped(bool reset); // Get the number of queued groups that missed their deadline, reset counter
+#endif
+
+#if QN800X_STATS
+    // Instrumentation
+
+    const QN800x_Stats &getStats();    // Bus, delay and RDS group counters since power up or the last reset
+    void resetStats();                 // Set all counters to 0
+#endif
   
 private:
 
 	uint8_t I2C_address;        // I2C Address of the QN8007
+    QN800x_Bus *bus;            // Transport all register I/O goes through
+#if QN800X_RDS
     uint8_t pstxC;              // Counter for of transmitted PS groups A0 or B0
     uint8_t rttxC;              // Counter for of transmitted RT group A2
     uint8_t rdsPI_h;            // PI Code high byte
     uint8_t rdsPI_l;            // PI Code low byte
+
+    uint8_t rdsMode;            // RDS engine state: RDS_IDLE, RDS_PS, RDS_RT or RDS_CAROUSEL
+    uint8_t rdsGrpC;            // Number of groups of the current sequence already loaded
+    uint32_t rdsLastT;          // micros() time stamp of the last group handed to the QN800x
+    uint32_t rdsPollT;          // micros() time stamp of the last STATUS3 read in RDS_PACE_CHIP
+    uint32_t rdsFreeT;          // micros() time stamp when the QN800x was ready for the next group
+    uint16_t rdsMissed;         // Counter for group slots that passed without new data
+    uint8_t rdsPace;            // Pacing mode RDS_PACE_FIXED, RDS_PACE_TIMER or RDS_PACE_CHIP
+    bool rdsFree;               // The QN800x is ready to take the next group
+    bool rdsUpd;                // Last seen state of the RDS_TXUPD bit
+    uint16_t rdsPTY;            // PTY of all groups
+    bool rdsB0;                 // Use group 0B instead of 0A for PS
+    bool rdsStereo;             // Stereo flag for the PS decoder identification
+    bool rdsAB;                 // RT text A/B flag
+    uint8_t rdsAF[8];           // AF list sent in block C of the 0A groups
+    uint8_t psImg[4][8];        // Ready to send RDS0...RDS7 images of the 4 PS groups
+    uint8_t rtImg[16][8];       // Ready to send RDS0...RDS7 images of the 16 RT groups
+    bool rtB;                   // RT uses 2B groups
+    bool rtIncr;                // Incremental RT updates
+    uint8_t rtSegN;             // Number of RT segments needed for the current text
+    uint16_t rtDirty;           // RT segments changed since they were last sent
+    uint16_t rtSeqMask;         // RT segments of the running RT sequence
+    bool rdsTP;                 // Traffic programme flag
+    bool rdsTA;                 // Traffic announcement flag
+    bool rdsMS;                 // Music/speech flag, true = music
+    bool rdsPre;                // Next slot is taken by a PS group with new flags
+    uint8_t psSeg;              // Next PS segment of the carousel
+    uint8_t rtSeg;              // Next RT segment of the carousel
+    uint8_t rdsW[3];            // Carousel weights for PS, RT and other groups
+    int16_t rdsCr[3];           // Carousel credits for PS, RT and other groups
+    QN800x_Group rdsQ[RDS_QUEUE]; // Queued groups with deadline
+    uint32_t ctLate;            // Lateness of the last clock time group
+    uint16_t rdsDropped;        // Queued groups that missed their deadline
+#endif
     
-    uint8_t buf[32];             // Data buffer for I2C
-    void SendData_(uint8_t len); // Function for sending data to registers
+    void init_();                // Common part of the constructors
+    uint8_t ReadRegs_(uint8_t reg, uint8_t *dst, uint8_t len); // Read len registers from reg on, returns count
+    uint8_t ReadReg_(uint8_t reg);   // Read a single register
+
+    uint8_t shadow[SH_LEN];          // Shadow copy of the setup registers
+    uint32_t shValid;                // Bit mask of shadow registers known to match the QN800x
+    uint32_t shDirty;                // Bit mask of shadow registers not yet written to the QN800x
+    uint8_t updDepth;                // Nesting depth of beginUpdate()
+    uint8_t shIdx_(uint8_t reg);     // Shadow index of a register
+    uint32_t cached_();              // Shadow registers that are used without reading the QN800x
+    uint8_t getReg_(uint8_t reg);    // Shadow value, fetched from the QN800x only if unknown
+    void writeReg_(uint8_t reg, uint8_t val);     // Write one register through the shadow
+    void setChannel_(uint16_t ch);                // CH and CH_STEP through the shadow, see setFrequency()
+    bool syncRegs_(uint8_t reg, uint8_t len);     // Fetch unknown registers of a range in one burst, false if some stay unknown
+    bool sendReg_(uint8_t reg);                   // Write one shadow register at once
+    bool flush_(uint32_t *sent = NULL);           // Write all dirty shadow registers, sent: mask of the registers put on the bus
+    bool SendBurst_(uint8_t reg, const uint8_t *data, uint8_t len); // Write len bytes from data to reg on
+
+    uint8_t busErr;                  // Error code of the last transaction that failed for good
+    uint8_t busFails;                // Number of transactions that failed for good, wraps
+    bool busRecov;                   // Bus recovery in progress
+    bool retry_(uint8_t n, uint8_t status); // Pause after failed attempt n, recover the bus after the last one
+    bool recover_();                 // Clock a hung bus free and restore the setup
+    void restore_();                 // Write all known shadow registers again
+    void wait_(uint32_t us);         // Delay that is counted in the stats
+    uint32_t blockBegin_();          // Start of a blocking call, returns micros()
+    void blockEnd_(uint32_t t0);     // End of a blocking call started at t0, counted in the stats
+#if QN800X_RDS
+    void encodePS_();                // Build blocks A, B, C of the PS group images
+    void encodeRT_();                // Build blocks A, B (C for 2B) of the RT group images
+    const uint8_t *nextGroup_(uint32_t now, uint8_t *qImg, int8_t &q); // Pick the next carousel group
+    int8_t pickQ_(uint32_t now, bool urgent); // Queued group that may go out now, -1 = none
+    uint32_t waitQ_(uint32_t now);            // µs until a queued group may go out, 0xFFFFFFFF = queue empty
+    void buildQ_(uint8_t i, uint8_t *img);    // Image of a queued group
+    uint16_t rdsFlags_(bool grp0);   // Block B flag bits of a group
+    uint16_t readyTime_(uint8_t segs, uint8_t weight); // Time in ms to send segs groups of one type
+    bool slotFree_(uint32_t now);    // Check if the QN800x is ready to take the next group
+    void shiftRDS_(uint32_t offset); // Move the next group slot offset µs from now
+#endif
+
+    uint8_t chip;                    // CHIP_NONE, CHIP_QN800X, CHIP_QN800XL or CHIP_UNKNOWN
+    uint8_t chipID;                  // CID2 register
+    bool rdsCap;                     // The chip has RDS
+    uint32_t startUs;                // Duration of the last begin()
+    bool waitReady_();               // Poll until the QN800x is out of reset, reads the chip ID
+    void applySetup_(const QN800x_Setup &setup); // Setters of a setup, inside an update
+    uint32_t rdsWait_();             // Time in µs until tick() has work, 0xFFFFFFFF = idle
+
+#if QN800X_STATS
+    QN800x_Stats stats;              // Counters returned by getStats()
+    uint16_t waitRest;               // Blocked µs below 1 ms, not yet in delayMs
+    uint8_t waitDepth;               // Inside a blocking call, which counts its whole time at the end
+    void waited_(uint32_t us);       // Add us µs to delayMs
+    uint8_t statsIdx_(uint8_t reg);  // Index of a register in the per register counters
+    void countIO_(uint8_t reg, uint8_t len, bool rd, uint8_t status); // Count one transaction
+#endif
 
 };
 
@@ -0,0 +1,221 @@
+/*
+QN8007 & QN8006 I2C FM Transmitter Library - Background RDS task
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+Author: Semir Nouri, December 2024
+
+*/
+
+#include <QN800x_Task.h>
+
+//-------------------Command Queue Section----------------------
+
+/* Single producer / single consumer: head is only written by the producer, tail
+ * only by the consumer. The slot is filled before head moves on (release) and
+ * read after head was seen (acquire), so no lock and no disabled interrupts are
+ * needed. The GCC atomic builtins exist for Xtensa, RISC-V, AVR and hosts alike.
+ */
+
+QN800x_Queue::QN800x_Queue()
+{
+    head = 0;
+    tail = 0;
+    dropped = 0;
+    notify = NULL;
+    notifyArg = NULL;
+}
+
+bool QN800x_Queue::post(const QN800x_Cmd &cmd)
+{
+    uint8_t h = head;                                        // Only this side writes head
+    uint8_t t = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+
+    if ((uint8_t) (h - t) == TASK_QUEUE_LEN) {dropped++; return false;} // Full, never wait
+
+    q[h % TASK_QUEUE_LEN] = cmd;
+    __atomic_store_n(&head, (uint8_t) (h + 1), __ATOMIC_RELEASE);
+
+    if (notify) notify(notifyArg);
+    return true;
+}
+
+bool QN800x_Queue::take(QN800x_Cmd &cmd)
+{
+    uint8_t t = tail;                                        // Only this side writes tail
+    uint8_t h = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+
+    if (h == t) return false;                                // Empty
+
+    cmd = q[t % TASK_QUEUE_LEN];
+    __atomic_store_n(&tail, (uint8_t) (t + 1), __ATOMIC_RELEASE);
+    return true;
+}
+
+uint32_t QN800x_Queue::getDropped()
+{
+    return dropped;
+}
+
+static bool postOp_(QN800x_Queue &q, uint8_t op, uint16_t arg, uint8_t flags, const char *text)
+{
+    QN800x_Cmd cmd;
+
+    cmd.op = op;
+    cmd.arg = arg;
+    cmd.flags = flags;
+    cmd.text[0] = 0;
+    if (text) {strncpy(cmd.text, text, 64); cmd.text[64] = 0;}
+
+    return q.post(cmd);
+}
+
+#if QN800X_RDS
+bool QN800x_Queue::postPS(const char *ps, uint16_t pty, bool useB0, bool stereo)
+{
+    return postOp_(*this, CMD_PS, pty, useB0 | (stereo << 1), ps);
+}
+
+bool QN800x_Queue::postRT(const char *rt, uint16_t pty, bool clrTXT)
+{
+    return postOp_(*this, CMD_RT, pty, clrTXT, rt);
+}
+#endif
+
+bool QN800x_Queue::postFrequency(uint16_t frequency)
+{
+    return postOp_(*this, CMD_FREQ, frequency, 0, NULL);
+}
+
+bool QN800x_Queue::postHop(uint16_t ch, bool mute)
+{
+    return postOp_(*this, CMD_HOP, ch, mute, NULL);
+}
+
+bool QN800x_Queue::postPower(uint8_t power)
+{
+    return postOp_(*this, CMD_POWER, power, 0, NULL);
+}
+
+bool QN800x_Queue::postMute(bool mute)
+{
+    return postOp_(*this, CMD_MUTE, mute, 0, NULL);
+}
+
+#if QN800X_RDS
+bool QN800x_Queue::postFlags(uint16_t pty, bool tp, bool ta, bool ms)
+{
+    return postOp_(*this, CMD_FLAGS, pty, tp | (ta << 1) | (ms << 2), NULL);
+}
+#endif
+
+//-------------------RDS Task Section---------------------------
+
+QN800x_Task::QN800x_Task(QN800x_TX &t) : tx(t)
+{
+    commands = 0;
+#ifdef ESP32
+    handle = NULL;
+#endif
+}
+
+QN800x_Queue &QN800x_Task::queue(uint8_t producer)
+{
+    return q[producer % TASK_PRODUCERS];
+}
+
+uint32_t QN800x_Task::getCommands()
+{
+    return commands;
+}
+
+void QN800x_Task::run_(QN800x_Cmd &cmd) // Only place the QN800x_TX is used once the task runs
+{
+    switch (cmd.op) 
+    {
+#if QN800X_RDS
+    case CMD_PS:    tx.loadRDS_PS(cmd.text, cmd.arg, bitRead(cmd.flags, 0), bitRead(cmd.flags, 1)); break;
+    case CMD_RT:    tx.loadRDS_RT(cmd.text, cmd.arg, bitRead(cmd.flags, 0)); tx.rushRT(); break; // First segment in the next carousel slot
+#endif
+    case CMD_FREQ:  tx.setFrequency(cmd.arg); break;
+    case CMD_HOP:   tx.hopChannel(cmd.arg, bitRead(cmd.flags, 0)); break;
+    case CMD_POWER: tx.setPower(cmd.arg); break;
+    case CMD_MUTE:  tx.setMute(cmd.arg); break;
+#if QN800X_RDS
+    case CMD_FLAGS: tx.startRDSflags(cmd.arg, bitRead(cmd.flags, 0), bitRead(cmd.flags, 1), bitRead(cmd.flags, 2)); break; // tick() sends it, no waiting here
+#endif
+    default: return;
+    }
+
+    commands++;
+}
+
+void QN800x_Task::service() // All posted commands first, they are short, then the RDS engine
+{
+    QN800x_Cmd cmd;
+
+    for (uint8_t i = 0; i < TASK_PRODUCERS; i++)
+    {
+        while (q[i].take(cmd)) {run_(cmd);}
+    }
+
+    tx.tick();
+}
+
+#ifdef ESP32
+
+void QN800x_Task::wake_(void *arg) // Producer side: wake the RDS task, never blocks
+{
+    xTaskNotifyGive((TaskHandle_t) arg);
+}
+
+void QN800x_Task::loop_(void *arg)
+{
+    QN800x_Task &task = *(QN800x_Task *) arg;
+
+    for (;;)
+    {
+        task.service();
+
+        /* Sleep until the next group slot or a posted command. The FreeRTOS tick is
+         * coarse (1...10 ms), the last part before the slot is waited in µs, so the
+         * group goes out on time however busy the decoder is on the other core.
+         */
+
+        uint32_t wait = task.tx.rdsWait_();
+        uint32_t tickUs = portTICK_PERIOD_MS * 1000UL;
+
+        if (wait > 2 * tickUs) {ulTaskNotifyTake(pdTRUE, wait / tickUs - 1);}
+        else if (wait > 0) {delayMicroseconds(wait);}
+        else {ulTaskNotifyTake(pdTRUE, 1);}      // Due but nothing sent, e.g. polling RDS_TXUPD: leave the core to others
+    }
+}
+
+bool QN800x_Task::start(uint8_t core, uint8_t prio)
+{
+    if (handle) return true;
+
+    if (xTaskCreatePinnedToCore(loop_, "QN800x", TASK_STACK, this, prio, &handle, core) != pdPASS) return false;
+
+    for (uint8_t i = 0; i < TASK_PRODUCERS; i++)
+    {
+        q[i].notifyArg = handle;
+        q[i].notify = wake_;
+    }
+
+    return true;
+}
+
+#endif
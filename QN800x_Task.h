@@ -0,0 +1,134 @@
+/*
+QN8007 & QN8006 I2C FM Transmitter Library - Background RDS task
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+On an ESP32 one task pinned to a core owns the QN800x_TX, its bus and the RDS
+carousel. Other tasks, e.g. the audio decoder or the metadata parser, never call
+QN800x_TX themselves. They post commands into their own QN800x_Queue: a lock-free
+single producer / single consumer ring buffer, posting never blocks and never
+waits for I2C. The task sleeps until the next group slot or a new command.
+PS and RT only change the group images, start the carousel before start() so
+they reach the air. A new RT goes out in the next slot (rushRT()).
+
+Each producer task uses its own queue(n), n = 0...TASK_PRODUCERS-1. The queue
+and service() are plain C++ and work on any host, start() needs FreeRTOS (ESP32).
+
+Author: Semir Nouri, December 2024
+
+*/
+
+#ifndef QN800x_Task_h
+#define QN800x_Task_h
+
+#include <QN800x_TX.h>
+
+#ifdef ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+#define TASK_QUEUE_LEN 8        /* Commands per queue, power of 2                      */
+#define TASK_PRODUCERS 2        /* Number of queues, one per posting task              */
+#define TASK_STACK 4096         /* Stack of the RDS task (bytes)                       */
+#define TASK_PRIO  5            /* Above the audio pipeline, an RDS slot is short      */
+#define TASK_CORE  0            /* Core of the RDS task, Karadio decodes on core 1     */
+
+#define CMD_PS     1            /* New PS, arg = PTY, flags bit 0 = 0B, bit 1 = stereo */
+#define CMD_RT     2            /* New RT, arg = PTY, flags bit 0 = A/B clear          */
+#define CMD_FREQ   3            /* setFrequency(arg)                                   */
+#define CMD_HOP    4            /* hopChannel(arg), flags bit 0 = mute                 */
+#define CMD_POWER  5            /* setPower(arg)                                       */
+#define CMD_MUTE   6            /* setMute(arg)                                        */
+#define CMD_FLAGS  7            /* startRDSflags(arg), flag bits 0...2 = TP, TA, M/S   */
+
+struct QN800x_Cmd
+{
+    uint8_t op;                 // CMD_PS...CMD_FLAGS
+    uint8_t flags;              // Op specific bits
+    uint16_t arg;               // Op specific value
+    char text[65];              // PS or RT, copied, the poster may reuse its buffer at once
+};
+
+class QN800x_Queue
+{
+
+public:
+
+    QN800x_Queue();
+
+    // Producer side, from one task only. All return false if the queue is full
+
+    bool post(const QN800x_Cmd &cmd);
+#if QN800X_RDS
+    bool postPS(const char *ps, uint16_t pty, bool useB0, bool stereo);
+    bool postRT(const char *rt, uint16_t pty, bool clrTXT);
+#endif
+    bool postFrequency(uint16_t frequency);
+    bool postHop(uint16_t ch, bool mute);
+    bool postPower(uint8_t power);
+    bool postMute(bool mute);
+#if QN800X_RDS
+    bool postFlags(uint16_t pty, bool tp, bool ta, bool ms);
+#endif
+    uint32_t getDropped();      // Commands lost because the queue was full
+
+    // Consumer side, the RDS task only
+
+    bool take(QN800x_Cmd &cmd);
+
+    void (*notify)(void *arg);  // Called after each post to wake the consumer, set by QN800x_Task
+    void *notifyArg;
+
+private:
+
+    QN800x_Cmd q[TASK_QUEUE_LEN];
+    uint8_t head;               // Next slot to fill, written by the producer only
+    uint8_t tail;               // Next slot to take, written by the consumer only
+    uint32_t dropped;           // Written by the producer only
+
+};
+
+class QN800x_Task
+{
+
+public:
+
+    QN800x_Task(QN800x_TX &tx);
+
+    QN800x_Queue &queue(uint8_t producer); // Queue of one posting task
+    void service();             // Run all posted commands, then tick() once. The task loop, or call it from loop()
+    uint32_t getCommands();     // Number of commands run
+
+#ifdef ESP32
+    bool start(uint8_t core = TASK_CORE, uint8_t prio = TASK_PRIO); // Start the pinned RDS task, setup is done before
+#endif
+
+private:
+
+    QN800x_TX &tx;              // The QN800x owned by the task
+    QN800x_Queue q[TASK_PRODUCERS];
+    uint32_t commands;          // Commands run
+    void run_(QN800x_Cmd &cmd); // Execute one command
+
+#ifdef ESP32
+    TaskHandle_t handle;        // RDS task
+    static void loop_(void *arg);
+    static void wake_(void *arg);
+#endif
+
+};
+
+#endif
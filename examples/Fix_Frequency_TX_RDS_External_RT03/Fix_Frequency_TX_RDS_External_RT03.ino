@@ -27,8 +27,12 @@
 */
 
 #include <QN800x_TX.h>
+#include <QN800x_Meta.h>
 
 QN800x_TX tx = QN800x_TX();
+QN800x_Meta meta;          // Collects RT input via RS232 e.g. from ESP32 Karadio byte by byte, no String
+
+const uint16_t sites[] = {QN800X_CHANNEL(938), QN800X_CHANNEL(947), QN800X_CHANNEL(1078)}; // Channels for the buttons, computed at compile time
 
 bool bSnew[] = {1, 1, 1, 1, 1, 1, 1, 1,}; // Button States for 8 buttons
 bool bSold[] = {0, 0, 0, 0, 0, 0, 0, 0,}; // Previous button states for 8 buttons
@@ -37,11 +41,10 @@ bool bSold[] = {0, 0, 0, 0, 0, 0, 0, 0,}; // Previous button states for 8 button
 uint16_t myPTY = 10;            // PTY, programme type number, change to suit your taste
 
 uint8_t txCount = 0;            // Counter for number of full RDS group transmissions
-bool clr = 1;                   // RDS text update toggle 8A/B Text bit)
-String myInput = ""; // RT input via RS232 e.g. from ESP32 Karadio
+bool newInput = false;          // New RT input waiting to be sent
 
 char myPS[] ="*Jamila*";        // Put your station name PS here
-char myText[65];                // Array place holder for RT text to be transmitted
+char myText[] = "Waiting...";   // RT text until the first title arrives
 
 /* Connections:
  * Arduino port A4 = SDA
@@ -59,56 +62,59 @@ void setup()
   Wire.begin();
   Wire.setClock(400000UL);
   Serial.begin(115200); // Speed needed for ESP32 Karadio Metadata transfer
+  meta.addPrefix("##CLI.META#"); // Karadio title lines, the prefix and ": " are cut off
    
   for (int i = 2; i < 10; i++) {pinMode(i, INPUT_PULLUP);} // Turn pins 2...9 into inputs
   pinMode(10, OUTPUT); pinMode(14, OUTPUT); // Pins for LEDs to Indicate PS & RT sending
 
 
-  tx.swReset(true); // Reset all registers to default at software start
-  delay(500); //Wait for the QN8007 to settle after reset
+  QN800x_Setup setup;        // Power up settings, begin() writes them in a few I2C bursts
 
-  tx.setExtClk(false); // Set to "true" if an external clock is input to pin 16. 
-  
-  tx.tuneXtal_Rin(1, 2); 
-  /* First value; Use 0...61 to get most precise output frequency, depends on crystal
-   * Second value: Use 0-3 equals 10k, 20k, 40k, 80k input impedance
-  */
-
-  tx.setDeviation(108);     // Set deviation of multiplex signal 108 = 75kHz, Formula 0,69kHz*value
-  tx.setDevPilot(9);        // Set Pilot deviation as percentage of main deviation 7%, 8%, 9%, 10% are possible
-  tx.setDevRDS(8);          // Set RDS carrier deviation. Default is 6 Range is 0-127
-  tx.initTransmit(1, 1, 1); // Start transmit mode, set Stereo, set I2S input, RDS active
-  tx.setFrequency(977);    // Set default frequency  
-}
+  setup.extClk = false;      // Set to "true" if an external clock is input to pin 16. 
+  setup.xtune = 1;           // Use 0...61 to get most precise output frequency, depends on crystal
+  setup.impedance = 2;       // Use 0-3 equals 10k, 20k, 40k, 80k input impedance
+  setup.deviation = 108;     // Set deviation of multiplex signal 108 = 75kHz, Formula 0,69kHz*value
+  setup.devPilot = 9;        // Set Pilot deviation as percentage of main deviation 7%, 8%, 9%, 10% are possible
+  setup.devRDS = 8;          // Set RDS carrier deviation. Default is 6 Range is 0-127
+  setup.stereo = true;       // Stereo
+  setup.I2S = true;          // I2S input, "false" for analog
+  setup.i2sRate = 0;         // 32, 40, 44 (44.1kHz) or 48, 0 keeps the power up I2S setting
+  setup.i2sMaster = true;    // "false" if the decoder drives BCK and WCK at its own rate, no resampling needed
+  setup.RDS = true;          // RDS active, switched off automatically on "L" parts
+  setup.frequency = 977;     // Set default frequency to 97.7MHz
 
-void serialEvent() 
-{  
-  myInput = Serial.readString();              // Read String from serial port
+  tx.begin(setup); // Reset, wait until the QN8007 answers instead of a fixed delay, then write all settings
 
-  if (myInput.startsWith("##CLI.META#"))
-  {
-    myInput.remove(myInput.length()-1, 1);    // Delete the last character of the input string   
-    myInput.remove(0, 13);                    // Delete the first 13 characters of the input string
-  } 
-  else myInput = "Waiting...";
+  /* The below sets the ratio of PS vs RT group slots to 40:15, the last weight is
+   * for other group types. PS and RT groups are interleaved one by one.
+   * digits after "myPTY "0" meams A0 Group is used, set to "1" for a B0 Group
+   * Some receivers seem to ignore B0 groups, however.
+   * Last digit "1" Means Stereo RDS flag set to "0" for Mono
+   */
 
-  while (myInput.length() < 64) {myInput = myInput + " ";}       // Add blanks to the end to pad to 64 characters
-  myText[myInput.length()+1]; strcpy(myText, myInput.c_str());   // Convert String to array
+  tx.setRDSweights(40, 15, 0);
+  tx.loadRDS_PS (myPS, myPTY, 0, 1);
+  tx.loadRDS_RT (myText, myPTY, 0);
+  tx.startCarousel();
+}
 
+void serialEvent() 
+{  
+  if (meta.poll(Serial) && meta.prefix() >= 0) newInput = true;  // Only Karadio title lines, others are ignored
 } 
 
 
 
-
 void loop()
 {
   // Section for test switches
 
   for (uint8_t j = 0; j < 8; j++) {bSnew[j] = digitalRead(j+2);} // Read and save all button states
 
-  if (bSnew[0] == 0) tx.setFrequency(938); // Button #1: Switch to 93.8MHz
-  if (bSnew[1] == 0) tx.setFrequency(947); // Button #2: Switch to 94.7MHz
-  if (bSnew[2] == 0) tx.setFrequency(1078);// Button #3: Switch to 107.8MHz
+  if (bSnew[0] == 0 && bSold[0] != bSnew[0]) tx.hopChannel(sites[0], true); // Button #1: Switch to 93.8MHz, muted while retuning
+  if (bSnew[1] == 0 && bSold[1] != bSnew[1]) tx.hopChannel(sites[1], true); // Button #2: Switch to 94.7MHz
+  if (bSnew[2] == 0 && bSold[2] != bSnew[2]) tx.hopChannel(sites[2], true); // Button #3: Switch to 107.8MHz
+  for (uint8_t j = 0; j < 3; j++) {bSold[j] = bSnew[j];}           // loop() runs fast now, act on button edges only
 
   if (bSnew[3] == 1 && bSold[3] != bSnew[3]) {tx.initTransmit(1, 1, 1); bSold[3] = bSnew[3];} // Digital input
   if (bSnew[3] == 0 && bSold[3] != bSnew[3]) {tx.initTransmit(1, 0, 1); bSold[3] = bSnew[3];} // Analog input
@@ -122,30 +128,26 @@ void loop()
      
   // RDS Section 
 
-  
-  /* The below sets the ratio of PS vs RT transmission times to 6:2.
-   * digits after "myPTY "0" meams A0 Group is used, set to "1" for a B0 Group
-   * Some receivers seem to ignore B0 groups, however.
-   * Last digit "1" Means Stereo RDS flag set to "0" for Mono
+  /* The RDS engine runs in the background. tick() hands the next group to the QN800x
+   * as soon as the time slot of the previous one is over and returns at once, so loop()
+   * keeps polling the buttons and the serial port while PS and RT are on air.
+   * The carousel mixes single PS and RT groups, see setRDSweights() in setup().
    */
- 
-  while (tx.getPScomplete(0) < 6)                             // Transmit PI, PTY and PS data 6 times before moving on
-  {
-    tx.setRDS_PS (myPS, myPTY, 0, 1);
-      if (tx.getPScomplete(0) == 1){digitalWrite (10, HIGH);} // Turn on PS LED
-      if (tx.getPScomplete(0) == 6){digitalWrite (10, LOW);}  // Turn off PS LED  
-  } 
 
-  while (tx.getRTcomplete(false) < 2)                         // Now transmit PI, PTY and RT data.  
+  tx.tick();
+
+  digitalWrite (10, tx.getPScomplete(0) & 1);                 // PS LED toggles with every complete PS
+  digitalWrite (14, tx.getRTcomplete(0) & 1);                 // RT LED toggles with every complete RT
+
+  if (newInput)                                               // Put new text on air with the next RT group
   {
-    tx.setRDS_RT (myText, myPTY, clr);
-      if (tx.getRTcomplete(0) == 1){digitalWrite (14, HIGH);} // Turn on RT LED
-      if (tx.getRTcomplete(0) == 2){digitalWrite (14, LOW);}  // Turn off RT LED 
-  }  
- 
-  tx.getPScomplete(1); tx.getRTcomplete(1); // Reset PS and RT counters
+    meta.apply(tx, myPTY);                                    // New A/B flag, first RT segment in the next group slot
+    newInput = false;
+  }
+
+  if (tx.getRTcomplete(0) < 2) return;                        // Wait for two complete RT transmissions
 
-  clr =!clr; // Toggle  Text A/B Bit to refresh RT screen on receiver
+  tx.getPScomplete(1); tx.getRTcomplete(1); // Reset PS and RT counters
 
   txCount++;          // Counts the number of times the RDS data transmission loop has run
     
@@ -154,8 +156,4 @@ void loop()
    * It is needed to avoid RDS hang on QN8007 only!
    * The QN8006 works without this patch.
    */
-  
-  
-
-
 }
@@ -0,0 +1,87 @@
+/* QN8007/QN8006 Example for several FM Transmitters with RDS behind an I2C multiplexer
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * For in depth information about RDS look for IEC 62106:1999 document
+
+ * Author: Semir Nouri, December 2024
+ *
+ */
+
+
+#include <QN800x_Fleet.h>
+
+#define TX_N 4                     // Number of transmitters, on mux channels 0...TX_N-1
+
+QN800x_WireBus wire(Wire);         // The mux is on Wire
+QN800x_Mux mux(wire, 0x70);        // TCA9548 at its default address
+
+QN800x_MuxPort port[TX_N] = {QN800x_MuxPort(mux, 1 << 0), QN800x_MuxPort(mux, 1 << 1), QN800x_MuxPort(mux, 1 << 2), QN800x_MuxPort(mux, 1 << 3)};
+QN800x_TX tx[TX_N] = {QN800x_TX(port[0]), QN800x_TX(port[1]), QN800x_TX(port[2]), QN800x_TX(port[3])};
+QN800x_Fleet fleet(mux);
+
+const uint16_t freq[TX_N] = {938, 947, 977, 1078}; // One frequency per transmitter
+char myPS[TX_N][9] = {"Studio 1", "Studio 2", "Studio 3", "Studio 4"};
+char myText[] = "Several transmitters, one bus";
+
+/* Connections:
+ * Arduino port A4 = SDA, A5 = SCL to the TCA9548, one QN800x on each of its channels
+ * The QN800x share one clock on pin 16, see setExtClk()
+ * Pin 10 LED shows the bus load
+ */
+
+void setup()
+{ 
+  Wire.begin();
+  Wire.setClock(400000UL);
+  pinMode(10, OUTPUT);
+
+  for (uint8_t i = 0; i < TX_N; i++) {fleet.add(tx[i], i);}
+
+  QN800x_Setup setup;        // Same settings for all transmitters
+  setup.extClk = true;       // Shared clock input on pin 16
+  setup.devRDS = 8;
+
+  fleet.begin(setup);        // Reset and set up every transmitter
+
+  setup.devPilot = 10;       // Later changes of the common settings go out once for all transmitters
+  fleet.broadcast(setup);    // Includes the frequency, so set the individual ones afterwards
+
+  for (uint8_t i = 0; i < TX_N; i++)
+  {
+    tx[i].hopChannel(QN800X_CHANNEL(freq[i]), false); // Each one on its own frequency
+    tx[i].loadRDS_PS (myPS[i], 10, 0, 1);
+    tx[i].loadRDS_RT (myText, 10, 0);
+  }
+
+  fleet.startCarousel();     // Group slots of the transmitters are spread over one group period
+}
+
+void loop()
+{
+  /* fleet.tick() serves the transmitter whose group slot is due first, so the
+   * transmitters never wait for each other on the shared bus.
+   */
+
+  fleet.tick();
+
+  static uint32_t loadT = 0;
+
+  if (millis() - loadT < 10000) return;         // Check the bus load every 10 s
+
+  digitalWrite(10, fleet.getBusLoad() > 500);   // LED on when more than half of the bus time is used
+  fleet.resetLoad();
+  loadT = millis();
+}
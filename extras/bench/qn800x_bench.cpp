@@ -0,0 +1,326 @@
+/* QN8007/QN8006 host benchmark: RDS group encoding, scheduling and bus cost
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * qn800x_bench runs QN800x_TX against a QN800x_SimBus on virtual time and writes
+ * one JSON document, so results of two releases can be compared line by line.
+ *
+ * - "cpu": host time per call, best of BENCH_RUNS runs. Depends on the machine,
+ *   compare only numbers taken on the same one.
+ * - "bus": I2C transactions, data bytes and bus time per operation at 100 and
+ *   400 kHz, counted from the simulated bus. Exact, the same on every machine.
+ * - in every "bus" entry also the RDS groups per second on air for each pacing
+ *   mode and the time until a PS or RT sequence is complete, in virtual time with
+ *   the bus time included.
+ *
+ * Build with the CMakeLists.txt of the library folder:
+ *
+ *   cmake -S . -B build && cmake --build build && build/qn800x_bench -o bench.json
+ *
+ * or "cmake --build build --target bench", which writes build/bench.json.
+ *
+ * Author: Semir Nouri, December 2024
+ *
+ */
+
+
+#include <QN800x_TX.h>
+#include <QN800x_Sim.h>
+#include <QN800x_RDScodec.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_RUNS 5            /* CPU timings: best of this many runs                 */
+#define BENCH_CALLS 20000       /* Calls per CPU timing run                            */
+#define BENCH_OPS 100           /* Repetitions of each bus operation                   */
+#define BENCH_AIR_S 60          /* Virtual seconds of carousel per pacing mode         */
+
+#if !QN800X_RDS
+#error qn800x_bench needs the RDS engine, set QN800X_RDS 1 in QN800x_Config.h
+#endif
+
+struct BusCount
+{
+    uint32_t transactions;
+    uint32_t writes;
+    uint32_t reads;
+    uint32_t bytes;             // Data bytes both ways, without address and sub address
+};
+
+static BusCount cnt;
+static uint32_t groupsOnAir = 0;
+static FILE *out = stdout;
+
+static char ps[2][9] = {"BENCH FM", "QN800x  "};
+static char rt[2][65] = {"Benchmark radio text with all 64 characters of a 2A RT group..",
+                         "A different text of 64 characters, so every segment changes...."};
+
+//-------------------Helper Section-----------------------------
+
+static uint64_t nowNs_() // Host clock, micros() runs on virtual time here
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void transfer_(const QN800x_SimEvent &e)
+{
+    cnt.transactions++;
+    if (e.read) cnt.reads++; else cnt.writes++;
+    cnt.bytes += e.len;
+}
+
+static void group_(const uint8_t group[8], uint32_t t)
+{
+    (void) group;
+    (void) t;
+    groupsOnAir++;
+}
+
+static bool start_(QN800x_SimBus &sim, QN800x_TX &tx, uint32_t hz) // Fresh chip with the default setup
+{
+    sim.useVirtualTime(true);
+    sim.setBusClock(hz);
+    sim.onTransfer = transfer_;
+    sim.onGroup = group_;
+
+    QN800x_Setup setup;
+    return tx.begin(setup);
+}
+
+static void op_(const char *name, const BusCount &c, uint32_t busUs, uint32_t n, bool last)
+{
+    fprintf(out, "      \"%s\": {\"transactions\": %.2f, \"writes\": %.2f, \"reads\": %.2f, \"bytes\": %.2f, \"bus_us\": %.1f}%s\n",
+            name, (double) c.transactions / n, (double) c.writes / n, (double) c.reads / n,
+            (double) c.bytes / n, (double) busUs / n, last ? "" : ",");
+}
+
+//-------------------CPU Section--------------------------------
+
+static double bestNs_(void (*run)(uint32_t), uint32_t calls) // ns per call, best of BENCH_RUNS
+{
+    double best = 1e30;
+
+    for (uint8_t r = 0; r < BENCH_RUNS; r++)
+    {
+        uint64_t t0 = nowNs_();
+        run(calls);
+        double ns = (double) (nowNs_() - t0) / calls;
+        if (ns < best) best = ns;
+    }
+
+    return best;
+}
+
+static QN800x_TX *cpuTx;
+static QN800x_RDSenc enc;
+static QN800x_RDSdec dec;
+static uint8_t bits[BENCH_CALLS][RDS_GROUP_BYTES];
+static volatile uint32_t sink;
+static double tickNs;                       // Set by tick_(), only the tick() calls count
+
+static void loadPS_(uint32_t n)  {for (uint32_t i = 0; i < n; i++) {cpuTx->loadRDS_PS(ps[i & 1], i & 31, false, true);}}
+static void loadRT_(uint32_t n)  {for (uint32_t i = 0; i < n; i++) {cpuTx->loadRDS_RT(rt[i & 1], 10, i & 1);}}
+static void rdsEnc_(uint32_t n)  {uint8_t g[8] = {0xD0, 0x22, 0x05, 0x40, 0xE0, 0xCD, 'Q', 'N'};
+                                  for (uint32_t i = 0; i < n; i++) {g[7] = i; enc.encode(g, bits[i]);}}
+static void rdsDec_(uint32_t n)  {for (uint32_t i = 0; i < n; i++) {for (uint8_t j = 0; j < RDS_GROUP_BYTES; j++) {sink += dec.putByte(bits[i][j]);}}}
+
+static void tick_(uint32_t n) // Host time of n group hand-overs, the waits between slots skipped
+{
+    uint64_t ns = 0;
+
+    for (uint32_t i = 0; i < n; )
+    {
+        uint32_t w = cpuTx->nextTick();
+        if (w) delayMicroseconds(w);                     // Virtual time, costs nothing
+
+        uint64_t t0 = nowNs_();
+        bool sent = cpuTx->tick();
+        ns += nowNs_() - t0;
+        if (sent) i++;
+    }
+
+    tickNs = (double) ns / n;
+}
+
+static void cpu_()
+{
+    QN800x_SimBus sim;
+    QN800x_TX tx(sim);
+    cpuTx = &tx;
+    start_(sim, tx, 0);                                  // No bus time, only host work
+
+    /* loadRDS_PS() with a new PTY re-encodes all PS and RT images, loadRDS_RT()
+     * with a new text all 16 RT images. Per group = per call / images built.
+     */
+
+    double psNs = bestNs_(loadPS_, BENCH_CALLS);
+    double rtNs = bestNs_(loadRT_, BENCH_CALLS);
+
+    tx.loadRDS_PS(ps[0], 10, false, true);
+    tx.loadRDS_RT(rt[0], 10, false);
+    tx.startCarousel();
+    double best = 1e30;
+    for (uint8_t r = 0; r < BENCH_RUNS; r++) {tick_(2000); if (tickNs < best) best = tickNs;}
+    tickNs = best;
+
+    double encNs = bestNs_(rdsEnc_, BENCH_CALLS);
+    double decNs = bestNs_(rdsDec_, BENCH_CALLS);
+
+    fprintf(out, "  \"cpu\": {\n");
+    fprintf(out, "    \"load_ps_ns\": %.1f,\n", psNs);
+    fprintf(out, "    \"load_rt_ns\": %.1f,\n", rtNs);
+    fprintf(out, "    \"encode_rt_ns_per_group\": %.1f,\n", rtNs / 16);
+    fprintf(out, "    \"tick_ns_per_group\": %.1f,\n", tickNs);
+    fprintf(out, "    \"rdsenc_ns_per_group\": %.1f,\n", encNs);
+    fprintf(out, "    \"rdsdec_ns_per_group\": %.1f\n", decNs);
+    fprintf(out, "  },\n");
+}
+
+//-------------------Bus Section--------------------------------
+
+static void bus_(uint32_t hz, bool last)
+{
+    QN800x_SimBus sim;
+    QN800x_TX tx(sim);
+
+    memset(&cnt, 0, sizeof(cnt));
+    uint32_t b0 = sim.busTime();
+    start_(sim, tx, hz);
+    BusCount begin = cnt;
+    uint32_t beginUs = sim.busTime() - b0;
+
+    fprintf(out, "    {\n");
+    fprintf(out, "      \"clock_hz\": %lu,\n", (unsigned long) hz);
+    op_("begin", begin, beginUs, 1, false);
+
+    memset(&cnt, 0, sizeof(cnt));
+    b0 = sim.busTime();
+    for (uint32_t i = 0; i < BENCH_OPS; i++) {tx.setFrequency((i & 1) ? 977 : 1013);}
+    op_("set_frequency", cnt, sim.busTime() - b0, BENCH_OPS, false);
+
+    memset(&cnt, 0, sizeof(cnt));
+    b0 = sim.busTime();
+    for (uint32_t i = 0; i < BENCH_OPS; i++) {tx.hopChannel((i & 1) ? QN800X_CHANNEL(977) : QN800X_CHANNEL(1013), true);}
+    op_("hop_channel", cnt, sim.busTime() - b0, BENCH_OPS, false);
+
+    memset(&cnt, 0, sizeof(cnt));
+    b0 = sim.busTime();
+    for (uint32_t i = 0; i < BENCH_OPS; i++) {tx.setMute(!(i & 1));}
+    op_("mute_toggle", cnt, sim.busTime() - b0, BENCH_OPS, false);
+
+    /* A full PS and RT cycle: 4 PS groups, then 16 RT groups of a 64 character
+     * text, blocking calls as a sketch without the RDS engine would use them.
+     */
+
+    uint32_t cycles = 5;
+    memset(&cnt, 0, sizeof(cnt));
+    b0 = sim.busTime();
+    uint32_t t0 = micros();
+    for (uint32_t i = 0; i < cycles; i++)
+    {
+        tx.setRDS_PS(ps[i & 1], 10, false, true);
+        tx.setRDS_RT(rt[i & 1], 10, i & 1);
+    }
+    uint32_t cycleUs = (micros() - t0) / cycles;
+    op_("ps_rt_cycle", cnt, sim.busTime() - b0, cycles, false);
+    fprintf(out, "      \"ps_rt_cycle_ms\": %.1f,\n", cycleUs / 1000.0);
+
+    // Time to complete a sequence, from the call until the last group was handed over
+
+    tx.startRDS_PS(ps[0], 10, false, true);
+    t0 = micros();
+    while (tx.rdsBusy()) {tx.tick();}
+    uint32_t psUs = micros() - t0;
+
+    tx.startRDS_RT(rt[1], 10, true);
+    t0 = micros();
+    while (tx.rdsBusy()) {tx.tick();}
+    uint32_t rtUs = micros() - t0;
+
+    fprintf(out, "      \"ps_complete_ms\": %.1f,\n", psUs / 1000.0);
+    fprintf(out, "      \"rt_complete_ms\": %.1f,\n", rtUs / 1000.0);
+
+    /* Groups on air per pacing mode, carousel with the default weights. tick() is
+     * called in a tight loop like from loop(). In RDS_PACE_CHIP the bus cost
+     * includes the STATUS3 reads, one every RDS_POLL_US from half a group after
+     * each load until the QN800x took the group.
+     */
+
+    static const char *paceName[3] = {"fixed", "timer", "chip"};
+
+    for (uint8_t pace = RDS_PACE_FIXED; pace <= RDS_PACE_CHIP; pace++)
+    {
+        tx.setRDSpacing(pace);
+        tx.startCarousel();
+        tx.getRDSmissed(true);
+
+        uint32_t g0 = groupsOnAir;
+        memset(&cnt, 0, sizeof(cnt));
+        b0 = sim.busTime();
+        t0 = millis();
+        while (millis() - t0 < BENCH_AIR_S * 1000UL) {tx.tick();}
+
+        uint32_t groups = groupsOnAir - g0;
+        uint32_t busUs = sim.busTime() - b0;
+
+        fprintf(out, "      \"carousel_%s\": {\"groups_per_s\": %.2f, \"missed\": %u, \"transactions_per_group\": %.2f, "
+                     "\"bytes_per_group\": %.2f, \"bus_load_permille\": %.2f},\n",
+                paceName[pace], (double) groups / BENCH_AIR_S, tx.getRDSmissed(true),
+                groups ? (double) cnt.transactions / groups : 0, groups ? (double) cnt.bytes / groups : 0,
+                (double) busUs / BENCH_AIR_S / 1000.0);
+
+        tx.stopRDS();
+    }
+
+    fprintf(out, "      \"ps_ready_ms\": %u,\n", tx.getPSready());
+    fprintf(out, "      \"rt_ready_ms\": %u\n", tx.getRTready());
+    fprintf(out, "    }%s\n", last ? "" : ",");
+}
+
+//-------------------Main Section-------------------------------
+
+int main(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc)
+        {
+            out = fopen(argv[++i], "w");
+            if (!out) {perror(argv[i]); return 1;}
+        }
+        else {fprintf(stderr, "qn800x_bench [-o file.json]\n"); return 2;}
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"benchmark\": \"qn800x_bench\",\n");
+    fprintf(out, "  \"config\": {\"stats\": %d, \"rds\": %d, \"i2s\": %d},\n", QN800X_STATS, QN800X_RDS, QN800X_I2S);
+    fprintf(out, "  \"group_us\": %lu,\n", (unsigned long) RDS_GROUP_US);
+
+    cpu_();
+
+    fprintf(out, "  \"bus\": [\n");
+    bus_(100000UL, false);
+    bus_(400000UL, true);
+    fprintf(out, "  ]\n");
+    fprintf(out, "}\n");
+
+    if (out != stdout) fclose(out);
+    return 0;
+}
@@ -0,0 +1,642 @@
+/* QN8007/QN8006 RDS and control daemon for Linux single board computers
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * qn800xd drives one QN800x on /dev/i2c-N, or up to FLEET_MAX behind a TCA9548,
+ * from one single threaded process. The process sleeps in epoll_wait() until
+ *
+ * - a timerfd armed from nextTick() says the next RDS group slot is due,
+ * - a second timerfd says a new minute is coming up, then a 4A clock time group
+ *   from the system clock is queued for every transmitter,
+ * - a command line arrives on stdin, a FIFO or a Unix socket.
+ *
+ * So it wakes up about 11 times per second and transmitter, nothing polls.
+ * With --sim the transmitters are QN800x_SimBus models on real time, which
+ * runs the whole daemon on a Linux box without any hardware.
+ *
+ * Build from the library folder:
+ *
+ *   g++ -O2 -I. extras/linux/qn800xd.cpp QN800x_TX.cpp QN800x_Bus.cpp QN800x_Port.cpp \
+ *       QN800x_Sim.cpp QN800x_Fleet.cpp QN800x_Meta.cpp QN800x_Charset.cpp -o qn800xd
+ *
+ * Run:
+ *
+ *   qn800xd --i2c /dev/i2c-1 --freq 97.7                     One QN800x
+ *   qn800xd --i2c /dev/i2c-1 --mux 0x70 --count 4            Four behind a TCA9548, each with its crystal
+ *   qn800xd --i2c /dev/i2c-1 --mux 0x70 --count 4 --ext-clk  The same with one shared clock
+ *   qn800xd --sim 4 --socket /tmp/qn800xd.sock --fifo /tmp/qn800xd.fifo
+ *
+ * Commands, one per line, optionally led by @N for transmitter N (default 0)
+ * or @* for all of them:
+ *
+ *   PS <text>        Program service name, UTF-8, 8 characters
+ *   RT <text>        Radio text, UTF-8, 64 characters, new A/B flag, first segment in the next slot
+ *   ##CLI.META#: ... Karadio metadata line, same as RT
+ *   PTY <0...31>     Program type
+ *   TP <0|1>         Traffic program
+ *   TA <0|1>         Traffic announcement, goes out in the next group slot
+ *   MS <0|1>         Speech (0) or music (1, default)
+ *   FREQ <MHz>       e.g. 97.7 or 977
+ *   POWER <0...15>   RF power
+ *   MUTE <0|1>       Audio mute
+ *   STATS            Group counters, clock time and bus load
+ *   QUIT             End the daemon
+ *
+ * Replies are "OK" or "ERR <reason>" to stdin and socket clients, FIFO lines get none.
+ *
+ * Author: Semir Nouri, December 2024
+ *
+ */
+
+
+#include <QN800x_Fleet.h>
+#include <QN800x_Meta.h>
+#include <QN800x_Sim.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+
+#define CLIENT_MAX 16           /* Input streams: stdin, FIFO and socket connections   */
+#define LINE_MAX_LEN 256        /* Longest command line, longer lines are dropped      */
+#define POLL_BACKOFF_US 1000    /* Wait before polling the QN800x again in RDS_PACE_CHIP */
+#define CT_LEAD_S 1             /* Queue the 4A group this many seconds before the minute */
+
+#if !QN800X_RDS
+#error qn800xd needs the RDS engine, set QN800X_RDS 1 in QN800x_Config.h
+#endif
+
+struct Station
+{
+    QN800x_TX *tx;
+    QN800x_Meta meta;           // Turns RT and metadata lines into RT, keeps the A/B flag
+    char ps[9];
+    uint16_t pty;
+    bool tp;
+    bool ta;
+    bool ms;                    // Music, false = speech
+    uint16_t freq;              // 760...1080
+};
+
+struct Client
+{
+    int fd;                     // Read side, -1 = unused
+    int out;                    // Where replies go, -1 = no replies
+    char line[LINE_MAX_LEN];
+    uint16_t len;
+    bool over;                  // Line too long, drop it
+};
+
+enum {EV_TICK = -1, EV_CT = -2, EV_SIGNAL = -3, EV_LISTEN = -4}; // epoll tags besides client slots
+
+static Station st[FLEET_MAX];
+static uint8_t stN = 1;
+static QN800x_Fleet *fleet = NULL;          // Several transmitters behind a mux, else st[0] alone
+static Client cl[CLIENT_MAX];
+static int ep = -1;
+static int tickFd = -1;
+static int ctFd = -1;
+static int listenFd = -1;
+static bool verbose = false;
+static bool running = true;
+static uint32_t simGroups = 0;              // Groups on air of all simulated chips
+
+//-------------------Helper Section-----------------------------
+
+static void watch_(int fd, int tag)
+{
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0;
+    ev.data.fd = tag;
+    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void armUs_(int fd, uint32_t us) // One shot in us µs, 0xFFFFFFFF = disarm
+{
+    struct itimerspec it;
+    memset(&it, 0, sizeof(it));
+
+    if (us != 0xFFFFFFFFUL)
+    {
+        if (us == 0) us = 1;                        // 0 would disarm the timer
+        it.it_value.tv_sec = us / 1000000UL;
+        it.it_value.tv_nsec = (us % 1000000UL) * 1000;
+    }
+
+    timerfd_settime(fd, 0, &it, NULL);
+}
+
+static void reply_(Client &c, const char *s)
+{
+    if (c.out < 0) return;
+    if (write(c.out, s, strlen(s)) < 0 && verbose) perror("reply");
+}
+
+static void simGroup_(const uint8_t group[8], uint32_t t)
+{
+    simGroups++;
+    if (verbose) printf("%10lu  on air  %02X%02X %02X%02X %02X%02X %02X%02X\n", (unsigned long) t,
+                        group[0], group[1], group[2], group[3], group[4], group[5], group[6], group[7]);
+}
+
+//-------------------RDS Section--------------------------------
+
+static uint32_t nextTick_()
+{
+    return fleet ? fleet->nextTick() : st[0].tx->nextTick();
+}
+
+static bool tick_()
+{
+    return fleet ? fleet->tick() : st[0].tx->tick();
+}
+
+static void serveRDS_() // Load every group that is due, then sleep until the next one
+{
+    /* In RDS_PACE_TIMER the wait is exact. In RDS_PACE_CHIP the engine starts
+     * polling half a group after a load, then a tick() without a group means
+     * the QN800x has not taken the last one yet, so look again a little later.
+     */
+
+    uint32_t w;
+
+    while ((w = nextTick_()) == 0)
+    {
+        if (!tick_()) {w = POLL_BACKOFF_US; break;}
+    }
+
+    armUs_(tickFd, w);
+}
+
+static void armCT_() // Wake up CT_LEAD_S before the next minute of the system clock
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    time_t edge = (now.tv_sec / 60 + 1) * 60;
+    if (edge - now.tv_sec <= CT_LEAD_S) edge += 60;     // Too close, take the one after
+
+    struct itimerspec it;
+    memset(&it, 0, sizeof(it));
+    it.it_value.tv_sec = edge - CT_LEAD_S;
+    timerfd_settime(ctFd, TFD_TIMER_ABSTIME, &it, NULL);
+}
+
+static void sendCT_() // 4A group for the coming minute, UTC plus the local offset
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint32_t t = micros();
+
+    time_t edge = (now.tv_sec / 60 + 1) * 60;
+    struct tm utc, loc;
+    gmtime_r(&edge, &utc);
+    localtime_r(&edge, &loc);
+
+    uint32_t mjd = QN800x_TX::toMJD(utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday);
+    int8_t offset = loc.tm_gmtoff / 1800;               // Half hours
+    uint32_t at = t + (uint32_t) (edge - now.tv_sec) * 1000000UL - now.tv_nsec / 1000;
+
+    for (uint8_t i = 0; i < stN; i++)
+    {
+        st[i].tx->setClock(mjd, utc.tm_hour, utc.tm_min, offset, at);
+    }
+
+    if (verbose) printf("CT %02d:%02d UTC queued\n", utc.tm_hour, utc.tm_min);
+
+    armCT_();
+}
+
+//-------------------Command Section----------------------------
+
+static void setPS_(Station &s, const char *text)
+{
+    char buf[LINE_MAX_LEN];
+    strncpy(buf, text, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0;
+
+    uint16_t n = QN800x_UTF8::convert(buf);
+    for (uint8_t i = 0; i < 8; i++) {s.ps[i] = (i < n) ? buf[i] : ' ';}
+    s.ps[8] = 0;
+
+    s.tx->loadRDS_PS(s.ps, s.pty, false, true);
+}
+
+static void setRT_(Station &s, const char *line) // Plain text or a metadata line with its prefix
+{
+    for (const char *p = line; *p; p++) {s.meta.feed(*p);}
+    s.meta.feed('\n');
+    s.meta.apply(*s.tx, s.pty);
+}
+
+static void stats_(Client &c)
+{
+    char msg[256];
+
+    for (uint8_t i = 0; i < stN; i++)
+    {
+        QN800x_TX &tx = *st[i].tx;
+        uint32_t late = tx.getCTlate();
+
+        int n = snprintf(msg, sizeof(msg), "@%u \"%s\" %u.%u MHz chip %u missed %u dropped %u",
+                         i, st[i].ps, st[i].freq / 10, st[i].freq % 10, tx.getChip(),
+                         tx.getRDSmissed(false), tx.getRDSdropped(false));
+#if QN800X_STATS
+        const QN800x_Stats &s = tx.getStats();
+        uint32_t groups = 0;
+        for (uint8_t g = 0; g < 32; g++) {groups += s.groups[g];}
+        n += snprintf(msg + n, sizeof(msg) - n, " groups %lu late %lu max %lu us",
+                      (unsigned long) groups, (unsigned long) s.late, (unsigned long) s.lateMaxUs);
+#endif
+        if (late != 0xFFFFFFFFUL) n += snprintf(msg + n, sizeof(msg) - n, " CT +%lu us", (unsigned long) late);
+        if (fleet) n += snprintf(msg + n, sizeof(msg) - n, " load %u/1000", fleet->getLoad(i));
+        snprintf(msg + n, sizeof(msg) - n, "\n");
+        reply_(c, msg);
+    }
+
+    if (simGroups) {snprintf(msg, sizeof(msg), "sim groups on air %lu\n", (unsigned long) simGroups); reply_(c, msg);}
+}
+
+static const char *station_(Station &s, const char *cmd, const char *arg) // Error text or NULL
+{
+    long v = strtol(arg, NULL, 10);
+
+    if (!strcasecmp(cmd, "PS")) {setPS_(s, arg); return NULL;}
+    if (!strcasecmp(cmd, "RT")) {setRT_(s, arg); return NULL;}
+    if (!strncmp(cmd, "##CLI.META#", 11)) {setRT_(s, cmd); return NULL;}
+
+    if (!strcasecmp(cmd, "PTY"))
+    {
+        if (v < 0 || v > 31) return "PTY 0...31";
+        s.pty = v;
+        s.tx->loadRDS_PS(s.ps, s.pty, false, true);     // New PTY in all group images
+        return NULL;
+    }
+
+    if (!strcasecmp(cmd, "TP") || !strcasecmp(cmd, "TA") || !strcasecmp(cmd, "MS"))
+    {
+        if (!strcasecmp(cmd, "TP")) s.tp = (v != 0);
+        else if (!strcasecmp(cmd, "TA")) s.ta = (v != 0);
+        else s.ms = (v != 0);
+        s.tx->startRDSflags(s.pty, s.tp, s.ta, s.ms);   // Queued, the loop's tick() sends it in the next group slot
+        return NULL;
+    }
+
+    if (!strcasecmp(cmd, "FREQ"))
+    {
+        double mhz = strtod(arg, NULL);
+        uint16_t f = (mhz < 200) ? (uint16_t) (mhz * 10 + 0.5) : (uint16_t) mhz;
+        if (!s.tx->setFrequency(f)) return "FREQ 76.0...108.0";
+        s.freq = f;
+        return NULL;
+    }
+
+    if (!strcasecmp(cmd, "POWER"))
+    {
+        if (v < 0 || v > 15) return "POWER 0...15";
+        s.tx->setPower(v);
+        return NULL;
+    }
+
+    if (!strcasecmp(cmd, "MUTE")) {s.tx->setMute(v != 0); return NULL;}
+
+    return "unknown command";
+}
+
+static void command_(Client &c, char *line)
+{
+    /* "[@N|@*] COMMAND argument". Metadata lines carry their own prefix and are
+     * passed on as they are, everything else is split at the first space.
+     */
+
+    uint8_t first = 0, last = 0;
+
+    while (*line == ' ' || *line == '\t') line++;
+    if (*line == 0) return;
+
+    if (*line == '@')
+    {
+        if (line[1] == '*') {first = 0; last = stN - 1; line += 2;}
+        else
+        {
+            char *end;
+            long n = strtol(line + 1, &end, 10);
+            if (end == line + 1 || n < 0 || n >= stN) {reply_(c, "ERR no such transmitter\n"); return;}
+            first = last = n;
+            line = end;
+        }
+        while (*line == ' ') line++;
+    }
+
+    char *arg = line;
+    if (strncmp(line, "##", 2)) {arg = strchr(line, ' '); arg = arg ? (*arg = 0, arg + 1) : line + strlen(line);}
+
+    if (!strcasecmp(line, "QUIT")) {running = false; reply_(c, "OK\n"); return;}
+    if (!strcasecmp(line, "STATS")) {stats_(c); reply_(c, "OK\n"); return;}
+
+    const char *err = NULL;
+    for (uint8_t i = first; i <= last && !err; i++) {err = station_(st[i], line, arg);}
+
+    if (verbose) printf("@%u %s %s: %s\n", first, line, (arg == line) ? "" : arg, err ? err : "OK");
+
+    if (err) {char msg[64]; snprintf(msg, sizeof(msg), "ERR %s\n", err); reply_(c, msg);}
+    else reply_(c, "OK\n");
+}
+
+//-------------------Input Section------------------------------
+
+static int addClient_(int fd, int out)
+{
+    for (int i = 0; i < CLIENT_MAX; i++)
+    {
+        if (cl[i].fd >= 0) continue;
+        cl[i].fd = fd;
+        cl[i].out = out;
+        cl[i].len = 0;
+        cl[i].over = false;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        watch_(fd, i);
+        return i;
+    }
+
+    return -1;
+}
+
+static void dropClient_(Client &c)
+{
+    epoll_ctl(ep, EPOLL_CTL_DEL, c.fd, NULL);
+    if (c.fd > 2) close(c.fd);
+    c.fd = -1;
+}
+
+static void readClient_(Client &c) // Split what arrived into lines, a partial line waits for the rest
+{
+    char buf[512];
+    ssize_t n = read(c.fd, buf, sizeof(buf));
+
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {dropClient_(c); return;}
+
+    for (ssize_t i = 0; i < n; i++)
+    {
+        char ch = buf[i];
+
+        if (ch == '\r') continue;
+        if (ch != '\n')
+        {
+            if (c.len < LINE_MAX_LEN - 1) c.line[c.len++] = ch; else c.over = true;
+            continue;
+        }
+
+        c.line[c.len] = 0;
+        if (c.over) reply_(c, "ERR line too long\n"); else command_(c, c.line);
+        c.len = 0;
+        c.over = false;
+    }
+}
+
+static int listen_(const char *path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    struct sockaddr_un sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strncpy(sa.sun_path, path, sizeof(sa.sun_path) - 1);
+    unlink(path);
+
+    if (fd < 0 || bind(fd, (struct sockaddr *) &sa, sizeof(sa)) < 0 || listen(fd, 4) < 0) {perror(path); exit(1);}
+    return fd;
+}
+
+static int fifo_(const char *path)
+{
+    if (mkfifo(path, 0660) < 0 && errno != EEXIST) {perror(path); exit(1);}
+
+    int fd = open(path, O_RDWR | O_NONBLOCK);   // Own write end: no EOF when a writer closes
+    if (fd < 0) {perror(path); exit(1);}
+    return fd;
+}
+
+//-------------------Main Section-------------------------------
+
+static void usage_()
+{
+    fprintf(stderr,
+        "qn800xd [options]\n"
+        "  --i2c DEV       I2C adapter, e.g. /dev/i2c-1\n"
+        "  --mux ADDR      TCA9548 address, e.g. 0x70, transmitters on channels 0...count-1\n"
+        "  --count N       Number of transmitters behind the mux (1...%u)\n"
+        "  --sim N         N simulated transmitters instead of --i2c\n"
+        "  --freq MHz      Start frequency, transmitter i gets MHz + i * 0.4\n"
+        "  --ps TEXT       Start PS\n"
+        "  --socket PATH   Unix socket for commands\n"
+        "  --fifo PATH     FIFO for commands\n"
+        "  --chip          RDS_PACE_CHIP instead of RDS_PACE_TIMER\n"
+        "  --ext-clk       External clock on pin 16 instead of the crystal, e.g. one shared clock\n"
+        "  --no-ct         No 4A clock time groups\n"
+        "  --no-stdin      Ignore stdin\n"
+        "  -v              Log commands, clock time and simulated groups\n", FLEET_MAX);
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option opts[] = {
+        {"i2c", 1, 0, 'i'}, {"mux", 1, 0, 'm'}, {"count", 1, 0, 'n'}, {"sim", 1, 0, 's'},
+        {"freq", 1, 0, 'f'}, {"ps", 1, 0, 'p'}, {"socket", 1, 0, 'u'}, {"fifo", 1, 0, 'o'},
+        {"chip", 0, 0, 'c'}, {"ext-clk", 0, 0, 'e'}, {"no-ct", 0, 0, 't'}, {"no-stdin", 0, 0, 'x'},
+        {0, 0, 0, 0}};
+
+    const char *dev = NULL, *sock = NULL, *fifo = NULL, *ps = "QN800x";
+    int muxAddr = -1, sim = 0;
+    double mhz = 97.7;
+    bool chipPace = false, extClk = false, ct = true, useStdin = true;
+    int o;
+
+    while ((o = getopt_long(argc, argv, "v", opts, NULL)) != -1)
+    {
+        switch (o)
+        {
+        case 'i': dev = optarg; break;
+        case 'm': muxAddr = strtol(optarg, NULL, 0); break;
+        case 'n': stN = atoi(optarg); break;
+        case 's': sim = atoi(optarg); stN = sim; break;
+        case 'f': mhz = atof(optarg); break;
+        case 'p': ps = optarg; break;
+        case 'u': sock = optarg; break;
+        case 'o': fifo = optarg; break;
+        case 'c': chipPace = true; break;
+        case 'e': extClk = true; break;
+        case 't': ct = false; break;
+        case 'x': useStdin = false; break;
+        case 'v': verbose = true; setvbuf(stdout, NULL, _IOLBF, 0); break;
+        default: usage_();
+        }
+    }
+
+    if (stN < 1 || stN > FLEET_MAX || (!sim && !dev)) usage_();
+    if (!sim && stN > 1 && muxAddr < 0) {fprintf(stderr, "--count > 1 needs --mux\n"); return 2;}
+
+    // Transport: simulated chips behind a simulated mux, or the real adapter
+
+    QN800x_Bus *bus;
+    static QN800x_LinuxBus linuxBus;
+    static QN800x_SimMux simMux;
+    static QN800x_SimBus chips[FLEET_MAX];
+
+    if (sim)
+    {
+        for (uint8_t i = 0; i < stN; i++) {simMux.attach(i, chips[i]); chips[i].onGroup = simGroup_;}
+        simMux.setBusClock(400000UL);
+        bus = &simMux;
+        muxAddr = 0x70;
+    }
+    else
+    {
+        if (!linuxBus.open(dev)) {perror(dev); return 1;}
+        bus = &linuxBus;
+    }
+
+    if (muxAddr >= 0)
+    {
+        QN800x_Mux *mux = new QN800x_Mux(*bus, muxAddr);
+        fleet = new QN800x_Fleet(*mux);
+        for (uint8_t i = 0; i < stN; i++)
+        {
+            st[i].tx = new QN800x_TX(*new QN800x_MuxPort(*mux, 1 << i));
+            fleet->add(*st[i].tx, i);
+        }
+    }
+    else
+    {
+        st[0].tx = new QN800x_TX(*bus);
+    }
+
+    // Transmitters: common setup, then one frequency and PS each
+
+    QN800x_Setup setup;
+    setup.extClk = extClk;                           // Crystal unless told otherwise, see Multi_TX_Mux for a shared clock
+    setup.frequency = (uint16_t) (mhz * 10 + 0.5);
+
+    for (uint8_t i = 0; i < stN; i++)                // Transmitter i gets frequency + 0.4 MHz * i
+    {
+        uint16_t f = setup.frequency + 4 * i;
+        if (mhz > 0 && f >= 760 && f <= 1080) continue;
+        fprintf(stderr, "Transmitter %u would be at %u.%u MHz, --freq and --count must keep all within 76.0...108.0\n",
+                i, f / 10, f % 10);
+        return 2;
+    }
+
+    if (!(fleet ? fleet->begin(setup) : st[0].tx->begin(setup))) {fprintf(stderr, "QN800x does not answer\n"); return 1;}
+
+    for (uint8_t i = 0; i < stN; i++)
+    {
+        Station &s = st[i];
+        s.pty = 0;
+        s.tp = s.ta = false;
+        s.ms = true;
+        s.freq = setup.frequency + 4 * i;
+        s.meta.addPrefix("##CLI.META#");
+
+        if (i) s.tx->setFrequency(s.freq);
+        if (chipPace) s.tx->setRDSpacing(RDS_PACE_CHIP);
+        setPS_(s, ps);
+        setRT_(s, "");
+        if (!fleet) s.tx->startCarousel();
+    }
+
+    if (fleet) fleet->startCarousel();              // Group slots spread over one group period
+
+    // Event sources
+
+    for (int i = 0; i < CLIENT_MAX; i++) {cl[i].fd = -1;}
+
+    ep = epoll_create1(EPOLL_CLOEXEC);
+    tickFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC); // Same clock as micros()
+    watch_(tickFd, EV_TICK);
+
+    if (ct)
+    {
+        ctFd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+        watch_(ctFd, EV_CT);
+        armCT_();
+    }
+
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGINT);
+    sigaddset(&sigs, SIGTERM);
+    sigprocmask(SIG_BLOCK, &sigs, NULL);
+    signal(SIGPIPE, SIG_IGN);                       // A client that left is noticed by read()
+    int sigFd = signalfd(-1, &sigs, SFD_NONBLOCK | SFD_CLOEXEC);
+    watch_(sigFd, EV_SIGNAL);
+
+    if (useStdin) addClient_(STDIN_FILENO, STDOUT_FILENO);
+    if (fifo) addClient_(fifo_(fifo), -1);
+    if (sock) {listenFd = listen_(sock); watch_(listenFd, EV_LISTEN);}
+
+    if (verbose) printf("qn800xd: %u transmitter(s), %s\n", stN, sim ? "simulated" : dev);
+
+    // Event loop
+
+    serveRDS_();
+
+    while (running)
+    {
+        struct epoll_event ev[8];
+        int n = epoll_wait(ep, ev, 8, -1);
+        if (n < 0 && errno != EINTR) {perror("epoll_wait"); break;}
+
+        for (int i = 0; i < n; i++)
+        {
+            int tag = ev[i].data.fd;
+            uint64_t exp;
+
+            switch (tag)
+            {
+            case EV_TICK: if (read(tickFd, &exp, sizeof(exp)) < 0) {} break;
+            case EV_CT: if (read(ctFd, &exp, sizeof(exp)) >= 0) sendCT_(); break;
+            case EV_SIGNAL: running = false; break;
+            case EV_LISTEN:
+            {
+                int fd = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC);
+                if (fd >= 0 && addClient_(fd, fd) < 0) close(fd);   // Full
+                break;
+            }
+            default: if (cl[tag].fd >= 0) readClient_(cl[tag]); break;
+            }
+        }
+
+        serveRDS_();                                // Whatever woke us up, groups that are due go first
+    }
+
+    for (uint8_t i = 0; i < stN; i++) {st[i].tx->stopRDS();}
+    if (sock) unlink(sock);
+
+    return 0;
+}
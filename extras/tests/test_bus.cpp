@@ -0,0 +1,441 @@
+/* QN8007/QN8006 regression test: reset, retry, recovery and RDS timing on the simulator
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Runs QN800x_TX against QN800x_SimBus on virtual time and checks what the
+ * chip got: begin() with ready polling and chip detection, warm restart from a
+ * snapshot, resets inside an update, repeated transactions after NACKs, recovery of a hung bus after a
+ * brown-out, a dead bus, the group rate and bus cost of the pacing modes, the
+ * blocking time counted in delayMs, broadcasts to a fleet behind a mux and
+ * millis() across the wrap of the µs counter.
+ * Registered with ctest by the CMakeLists.txt of the library folder.
+ *
+ * Author: Semir Nouri, December 2024
+ *
+ */
+
+
+#include <QN800x_TX.h>
+#include <QN800x_Sim.h>
+#include <QN800x_Fleet.h>
+
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(cond) do {if (!(cond)) {printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++;}} while (0)
+
+static uint32_t reads = 0;
+static uint32_t written = 0;                // Bit n: register n was written, 0x00...0x1F
+
+static void transfer_(const QN800x_SimEvent &e)
+{
+    if (e.read) reads++;
+    if (!e.read && e.status == 0) {for (uint8_t r = e.reg; r < e.reg + e.len && r < 32; r++) {written |= 1UL << r;}}
+}
+
+static void run_(QN800x_TX &tx, uint32_t ms) // tick() for ms milliseconds of virtual time
+{
+    uint32_t t0 = millis();
+    while (millis() - t0 < ms) {tx.tick();}
+}
+
+//-------------------Reset Section------------------------------
+
+static void testBegin_()
+{
+    QN800x_SimBus sim;
+    sim.useVirtualTime(true);
+    QN800x_TX tx(sim);
+
+    QN800x_Setup setup;
+    setup.frequency = 1000;
+    setup.power = 10;
+
+    CHECK(tx.begin(setup));
+    CHECK(tx.getChip() == CHIP_QN800X);
+    CHECK(tx.hasRDS());
+    CHECK(tx.getStartupTime() < SIM_RESET_US + 5000);               // Polled, not the old 500 ms
+    CHECK(sim.peek(CH) == (QN800X_CHANNEL(1000) & 0xFF));
+    CHECK(sim.peek(PAG_CAL) == QN800X_PAG(10));
+
+    uint8_t sys0 = sim.peek(SYSTEM0);
+    uint8_t ch = sim.peek(CH);
+    QN800x_Snapshot snap;
+    tx.saveSnapshot(snap);
+
+    sim.powerUp();                                                  // Power cycle, then warm restart
+    CHECK(tx.begin(snap));
+    CHECK(sim.peek(SYSTEM0) == sys0);
+    CHECK(sim.peek(CH) == ch);
+    CHECK(sim.peek(PAG_CAL) == QN800X_PAG(10));
+
+    QN800x_SimBus simL;                                             // "L" part without RDS
+    simL.useVirtualTime(true);
+    simL.setChipID(CID_QN800XL << 2);
+    QN800x_TX txL(simL);
+    CHECK(txL.begin(setup));
+    CHECK(txL.getChip() == CHIP_QN800XL);
+    CHECK(!txL.hasRDS());
+
+    QN800x_SimBus none(0x2C);                                       // Nobody at 0x2B
+    none.useVirtualTime(true);
+    QN800x_TX txN(none);
+    uint32_t t0 = millis();
+    CHECK(!txN.begin(setup));
+    CHECK(txN.getChip() == CHIP_NONE);
+    CHECK(millis() - t0 <= BEGIN_TIMEOUT_MS + 10);
+}
+
+static QN800x_SimBus *pulseSim = NULL;
+static uint8_t bbLow = 0;                   // Writes that left the base band in reset
+
+static void pulse_(const QN800x_SimEvent &e)
+{
+    if (!e.read && e.reg == ANACTL1 && !bitRead(pulseSim->peek(ANACTL1), 5)) bbLow++;
+}
+
+static void testResets_() // Resets inside beginUpdate()/commitUpdate() are not collected
+{
+    QN800x_SimBus sim;
+    sim.useVirtualTime(true);
+    QN800x_TX tx(sim);
+
+    QN800x_Setup setup;
+    setup.power = 10;
+    CHECK(tx.begin(setup));
+
+    pulseSim = &sim;
+    sim.onTransfer = pulse_;
+    tx.beginUpdate();
+    tx.bbReset(5);
+    CHECK(bbLow == 1);                                              // Low edge on the bus before the wait
+    CHECK(bitRead(sim.peek(ANACTL1), 5));
+    tx.commitUpdate();
+    sim.onTransfer = NULL;
+
+    tx.beginUpdate();
+    tx.swReset(true);
+    CHECK(sim.peek(PAG_CAL) == 0);                                  // Power up value, the reset went out
+    tx.commitUpdate();
+}
+
+//-------------------Retry and Recovery Section-----------------
+
+static void testRetry_()
+{
+    QN800x_SimBus sim;
+    sim.useVirtualTime(true);
+    QN800x_TX tx(sim);
+
+    QN800x_Setup setup;
+    setup.frequency = 1000;
+    CHECK(tx.begin(setup));
+
+    char ps[] = "TESTFM  ";
+    tx.loadRDS_PS(ps, 10, false, true);
+    tx.startCarousel();
+    run_(tx, 1000);
+
+    // Two data NACKs: repeated, no recovery, nothing lost
+
+    sim.injectFault(2, 3);
+    run_(tx, 1000);
+    CHECK(tx.getBusError(false) == 0);
+    CHECK(sim.groupsLost == 0);
+#if QN800X_STATS
+    const QN800x_Stats &s = tx.getStats();
+    CHECK(s.retries == 2);
+    CHECK(s.recoveries == 0);
+    CHECK(s.failed == 0);
+#endif
+
+    // Brown-out and a hung bus: clocked free, setup written again
+
+    uint8_t ch = sim.peek(CH);
+    uint8_t sys0 = sim.peek(SYSTEM0);
+    sim.onTransfer = transfer_;
+    written = 0;
+    sim.powerUp();
+    sim.hang();
+    run_(tx, 1000);
+    sim.onTransfer = NULL;
+    CHECK(sim.recoveries == 1);
+    CHECK((written & 0x3064UL) == 0);                               // Never 0x02, CID1, CID2, 0x0C, 0x0D
+    CHECK(sim.peek(CH) == ch);
+    CHECK(sim.peek(SYSTEM0) == sys0);
+    CHECK(sim.groupsSent >= 5);                                     // RDS runs again, powerUp() cleared the counters
+#if QN800X_STATS
+    CHECK(s.recoveries == 1);
+    CHECK(s.failed == 0);
+#endif
+
+    // Nobody answers any more: the error is reported, nothing hangs
+
+    sim.injectFault(100, 2);
+    tx.setPower(3);
+    CHECK(tx.getBusError(true) == 2);
+    sim.injectFault(0, 0);
+}
+
+//-------------------RDS Timing Section-------------------------
+
+static void testPacing_()
+{
+    static const uint8_t pace[3] = {RDS_PACE_FIXED, RDS_PACE_TIMER, RDS_PACE_CHIP};
+    static const uint16_t minGroups[3] = {99, 113, 113};            // In 10 s: 100 ms slots, 87.579 ms slots
+
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        QN800x_SimBus sim;
+        sim.useVirtualTime(true);
+        sim.setBusClock(100000UL);
+        sim.onTransfer = transfer_;
+        QN800x_TX tx(sim);
+
+        QN800x_Setup setup;
+        CHECK(tx.begin(setup));
+
+        char ps[] = "TESTFM  ";
+        char rt[] = "Pacing test";
+        tx.loadRDS_PS(ps, 10, false, true);
+        tx.loadRDS_RT(rt, 10, false);
+        tx.setRDSpacing(pace[i]);
+        tx.startCarousel();
+        run_(tx, 100);
+
+        uint32_t g0 = sim.groupsSent;
+        reads = 0;
+        run_(tx, 10000);
+        uint32_t groups = sim.groupsSent - g0;
+
+        CHECK(groups >= minGroups[i] && groups <= 115);
+        CHECK(tx.getRDSmissed(false) == 0);
+        CHECK(sim.groupsLost == 0);
+        if (pace[i] == RDS_PACE_CHIP) CHECK(reads <= groups * 16);   // STATUS3 polled every RDS_POLL_US only
+        if (pace[i] != RDS_PACE_CHIP) CHECK(reads == 0);
+    }
+}
+
+static void testPScount_() // PS groups for new flags count towards getPScomplete()
+{
+    QN800x_SimBus sim;
+    sim.useVirtualTime(true);
+    QN800x_TX tx(sim);
+
+    QN800x_Setup setup;
+    CHECK(tx.begin(setup));
+
+    char ps[] = "COUNT   ";
+    tx.loadRDS_PS(ps, 10, false, true);
+    tx.setRDSweights(1, 0, 0);                                      // PS groups only
+    tx.startCarousel();
+    run_(tx, 100);
+
+    uint32_t g0 = sim.groupsSent;
+    tx.getPScomplete(true);
+
+    for (uint8_t i = 0; i < 10; i++)
+    {
+        tx.startRDSflags(10, true, i & 1, true);
+        run_(tx, 3 * RDS_GROUP_US / 1000);
+    }
+
+    uint32_t groups = sim.groupsSent - g0;
+    CHECK(groups >= 28);
+    uint8_t done = tx.getPScomplete(false);
+    CHECK(done >= groups / 4 && done <= (groups + 3) / 4);          // Every 4th PS group completes one, whatever the segment at g0
+}
+
+static uint32_t ctT = 0;                    // micros() time a 4A group went on air, 0 = none yet
+
+static void group_(const uint8_t group[8], uint32_t t)
+{
+    if ((group[2] >> 3) == RDS_GRP_4A && ctT == 0) ctT = t;
+}
+
+static void testIdleQueue_() // Clock time goes out with no sequence or carousel running
+{
+    QN800x_SimBus sim;
+    sim.useVirtualTime(true);
+    sim.onGroup = group_;
+    QN800x_TX tx(sim);
+
+    QN800x_Setup setup;
+    CHECK(tx.begin(setup));
+    CHECK(tx.nextTick() == 0xFFFFFFFFUL);                           // Nothing to do
+
+    uint32_t at = micros() + 2000000UL;                             // Next minute starts in 2 s
+    ctT = 0;
+    CHECK(tx.setClock(60661, 12, 0, 2, at));
+    CHECK(tx.nextTick() > 0 && tx.nextTick() <= 2000000UL);         // An event loop sleeps until the slot before the minute
+
+    uint32_t w;
+    while ((w = tx.nextTick()) != 0xFFFFFFFFUL && (int32_t) (micros() - at) < 1000000L)
+    {
+        delayMicroseconds(w);                                       // Sleep like qn800xd, then serve
+        tx.tick();
+    }
+
+    delayMicroseconds(RDS_GROUP_US);                                // The QN800x fetches it at the next group boundary
+    sim.peek(STATUS3);
+
+    CHECK(ctT != 0);
+    CHECK((int32_t) (ctT - at) >= -(int32_t) RDS_GROUP_US && (int32_t) (ctT - at) <= (int32_t) (RDS_CT_SLACK_US + RDS_GROUP_US));
+    CHECK(tx.getCTlate() <= RDS_GROUP_US + RDS_CT_SLACK_US);        // Handed over before its deadline
+    CHECK(tx.getRDSdropped(false) == 0);
+    CHECK(tx.getRDSmissed(false) == 0);
+    CHECK(tx.nextTick() == 0xFFFFFFFFUL);                           // Queue empty again
+}
+
+//-------------------Blocking Time Section----------------------
+
+static void testDelay_()
+{
+#if QN800X_STATS
+    QN800x_SimBus sim;
+    sim.useVirtualTime(true);
+    QN800x_TX tx(sim);
+
+    QN800x_Setup setup;
+    CHECK(tx.begin(setup));
+    const QN800x_Stats &s = tx.getStats();
+
+    tx.resetStats();
+    tx.hopChannel(QN800X_CHANNEL(1013), true);                      // Muted for HOP_SETTLE_US
+    CHECK(s.delayMs == HOP_SETTLE_US / 1000);
+
+    tx.resetStats();
+    tx.bbReset(5);
+    CHECK(s.delayMs == 5);
+
+    tx.resetStats();
+    sim.injectFault(2, 3);                                          // Backoff 200 + 400 µs, then the wait below
+    char ps[] = "DELAY   ";
+    uint32_t t0 = micros();
+    tx.setRDS_PS(ps, 1, false, true);                               // Blocks for 4 group slots
+    uint32_t ms = (micros() - t0) / 1000;
+    CHECK(s.retries == 2);
+    CHECK(s.delayMs + 1 >= ms && s.delayMs <= ms);                  // Counted once, not again for the backoff
+    CHECK(s.delayMs >= 3 * RDS_GROUP_US / 1000);
+#endif
+}
+
+//-------------------Fleet Section------------------------------
+
+static bool agrees_(QN800x_TX &tx, QN800x_SimBus &sim) // Every known setup register of tx is what the chip holds
+{
+    QN800x_Snapshot snap;
+    tx.saveSnapshot(snap);
+
+    for (uint8_t r = 0; r <= RDSFDEV; r++)
+    {
+        if (bitRead(snap.valid, r) && sim.peek(r) != snap.regs[r]) return false;
+    }
+    return sim.peek(PAG_CAL) == snap.regs[SH_PAG_CAL];
+}
+
+static void testFleet_()
+{
+    QN800x_SimMux smux;
+    QN800x_SimBus sim[3];
+    QN800x_Mux mux(smux);
+    QN800x_MuxPort port0(mux, 1 << 0), port1(mux, 1 << 1), port2(mux, 1 << 2);
+    QN800x_TX tx0(port0), tx1(port1), tx2(port2);
+    QN800x_Fleet fleet(mux);
+
+    for (uint8_t i = 0; i < 3; i++) {sim[i].useVirtualTime(true); smux.attach(i, sim[i]);}
+    fleet.add(tx0, 0);
+    fleet.add(tx1, 1);
+    fleet.add(tx2, 2);
+
+    QN800x_Setup setup;
+    CHECK(fleet.begin(setup));
+
+    tx1.setMute(true);                                              // Members differ outside the setup
+    tx1.setPower(3);
+    tx2.setPower(7);
+
+    QN800x_Snapshot snap;                                           // 0x09 of member 1 differs, bridged by CH...CH_STEP
+    tx1.saveSnapshot(snap);
+    snap.regs[0x09] = 0x55;
+    CHECK(tx1.begin(snap));
+
+    // Bridged registers of the first member never overwrite another member
+
+    setup.frequency = 1013;
+    setup.deviation = 100;
+    CHECK(fleet.broadcast(setup));
+    for (uint8_t i = 0; i < 3; i++) {CHECK(agrees_(fleet[i], sim[i]));}
+    CHECK(sim[1].peek(ANACTL1) & 0x80);
+    CHECK(sim[1].peek(PAG_CAL) == QN800X_PAG(3));
+    CHECK(sim[1].peek(0x09) == 0x55);
+    CHECK(sim[0].peek(CH) == (QN800X_CHANNEL(1013) & 0xFF));
+
+    // A broadcast that fails for good is not recovered through the broadcast port
+
+    for (uint8_t i = 0; i < 3; i++) {sim[i].injectFault(BUS_RETRIES + 1, 2);}
+    setup.frequency = 1042;
+    fleet.broadcast(setup);
+    for (uint8_t i = 0; i < 3; i++) {sim[i].injectFault(0, 0);}
+    for (uint8_t i = 0; i < 3; i++) {CHECK(agrees_(fleet[i], sim[i]));}
+    CHECK(sim[2].peek(PAG_CAL) == QN800X_PAG(7));
+    CHECK(sim[1].peek(CH) == (QN800X_CHANNEL(1042) & 0xFF));
+}
+
+//-------------------Host Clock Section-------------------------
+
+static uint32_t fakeUs = 0;
+
+static uint32_t fakeNow_()
+{
+    return fakeUs;
+}
+
+static void fakeWait_(uint32_t us)
+{
+    fakeUs += us;
+}
+
+static void testClock_() // millis() keeps counting when the µs counter wraps after 71.6 minutes
+{
+    fakeUs = 0;
+    setHostClock(fakeNow_, fakeWait_);
+
+    fakeUs = 4294000000UL;                                          // 1 s before the µs counter wraps
+    uint32_t m0 = millis();
+    uint32_t u0 = micros();
+    delay(2000);
+    CHECK(millis() - m0 == 2000);
+    CHECK(micros() - u0 == 2000000UL);
+
+    setHostClock(NULL, NULL);
+}
+
+int main()
+{
+    testBegin_();
+    testResets_();
+    testRetry_();
+    testPacing_();
+    testPScount_();
+    testIdleQueue_();
+    testDelay_();
+    testFleet_();
+    testClock_();
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,325 @@
+/* QN8007/QN8006 regression test: RDS block encoder and decoder
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Encodes 0A, 2A and 4A groups with QN800x_RDSenc and decodes the bit stream
+ * with QN800x_RDSdec: checkwords and syndromes of every offset word, a clean
+ * stream starting at an odd bit, single bit errors that must cost one group
+ * but not the block sync, and bit slips that must be found and synced again.
+ * Then end to end: the carousel of a QN800x_TX on QN800x_SimBus goes through
+ * onGroup, the encoder and the decoder, and PI, PS segment addresses, RT
+ * segments, the 0x0D end marker and the RT A/B flag are read back.
+ * Registered with ctest by the CMakeLists.txt of the library folder.
+ *
+ * Author: Semir Nouri, December 2024
+ *
+ */
+
+
+#include <QN800x_RDScodec.h>
+#include <QN800x_TX.h>
+#include <QN800x_Sim.h>
+
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(cond) do {if (!(cond)) {printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++;}} while (0)
+
+#define GROUPS 60                                   // 0A, 2A and 4A in turn
+#define BITS   (GROUPS * RDS_GROUP_BYTES * 8)
+
+static uint8_t grp[GROUPS][8];                      // RDS0...RDS7 of every group
+static uint8_t stream[BITS];                        // One channel bit per byte
+
+static void makeGroups_()
+{
+    static const char ps[] = "QN800X  ";
+    static const char rt[] = "Codec test of 2A groups  ";
+
+    for (uint16_t i = 0; i < GROUPS; i++)
+    {
+        uint8_t *g = grp[i];
+        uint8_t seg = i / 3;
+
+        g[0] = 0xC2;                                // PI
+        g[1] = 0x01;
+
+        switch (i % 3)
+        {
+        case 0:                                     // 0A: PS segment, AF in block C
+            g[2] = 0x04;                            // Type 0, version A, TP, PTY 0
+            g[3] = 0x08 | (seg & 3);                // TA off, M/S music, address
+            g[4] = 0xE0 + 1;                        // One AF
+            g[5] = 0xCD;
+            g[6] = ps[2 * (seg & 3)];
+            g[7] = ps[2 * (seg & 3) + 1];
+            break;
+        case 1:                                     // 2A: RT segment
+            g[2] = 0x24;
+            g[3] = seg & 0x0F;
+            g[4] = rt[(4 * seg) % 24];
+            g[5] = rt[(4 * seg + 1) % 24];
+            g[6] = rt[(4 * seg + 2) % 24];
+            g[7] = rt[(4 * seg + 3) % 24];
+            break;
+        default:                                    // 4A: MJD 60661, 12:00 + seg minutes UTC
+            g[2] = 0x44;
+            g[3] = 0x01;
+            g[4] = 0xDA;
+            g[5] = 0x6B;
+            g[6] = 0xC0 | (seg >> 6);
+            g[7] = (seg << 2) & 0xFC;
+            break;
+        }
+    }
+}
+
+static void makeStream_()
+{
+    QN800x_RDSenc enc;
+    uint8_t out[RDS_GROUP_BYTES];
+    uint32_t n = 0;
+
+    for (uint16_t i = 0; i < GROUPS; i++)
+    {
+        enc.encode(grp[i], out);
+        for (uint8_t k = 0; k < RDS_GROUP_BYTES * 8; k++) {stream[n++] = (out[k >> 3] >> (7 - (k & 7))) & 1;}
+    }
+}
+
+/* Feeds bits from..BITS-1 of the stream, with the bit at flip inverted and the
+ * bit at drop left out (-1 = none). Every decoded group must be one of the
+ * groups sent, in order. Returns the number of groups decoded.
+ */
+
+static uint16_t decode_(QN800x_RDSdec &dec, uint32_t from, int32_t flip, int32_t drop, int16_t *firstAfter = NULL, uint32_t mark = 0)
+{
+    uint16_t got = 0;
+    int16_t next = 0;                               // Lowest group index still possible
+
+    for (uint32_t n = from; n < BITS; n++)
+    {
+        if ((int32_t) n == drop) continue;
+
+        if (!dec.put(stream[n] ^ ((int32_t) n == flip))) continue;
+
+        int16_t i = next;
+        while (i < GROUPS && memcmp(dec.group(), grp[i], 8) != 0) {i++;}
+        CHECK(i < GROUPS);                          // Never a group that was not sent
+        if (i >= GROUPS) continue;
+
+        if (firstAfter && *firstAfter < 0 && n >= mark) *firstAfter = i;
+        next = i + 1;
+        got++;
+    }
+
+    return got;
+}
+
+//-------------------Block Section------------------------------
+
+static void testBlocks_()
+{
+    static const uint16_t ofs[5] = {RDS_OFS_A, RDS_OFS_B, RDS_OFS_C, RDS_OFS_CX, RDS_OFS_D};
+    static const uint16_t syn[5] = {RDS_SYN_A, RDS_SYN_B, RDS_SYN_C, RDS_SYN_CX, RDS_SYN_D};
+    static const uint16_t data[6] = {0x0000, 0xFFFF, 0xC201, 0x0408, 0x2400, 0x44DA};
+
+    CHECK(QN800x_RDSenc::check(0) == 0);
+    CHECK(QN800x_RDSenc::check(1) == (RDS_POLY & 0x3FF));   // x^10 mod g(x)
+
+    for (uint8_t o = 0; o < 5; o++)
+    {
+        for (uint8_t d = 0; d < 6; d++)
+        {
+            uint32_t b = QN800x_RDSenc::block(data[d], ofs[o]);
+            CHECK((b >> 10) == data[d]);
+            CHECK(((b ^ ofs[o]) & 0x3FF) == QN800x_RDSenc::check(data[d]));
+            CHECK(QN800x_RDSdec::syndrome(b) == syn[o]);
+
+            for (uint8_t k = 0; k < 26; k++)        // Any single bit error is seen
+            {
+                CHECK(QN800x_RDSdec::syndrome(b ^ (1UL << k)) != syn[o]);
+            }
+
+            for (uint8_t k = 0; k < 25; k++)        // So are the two bit bursts of the differential decoding
+            {
+                CHECK(QN800x_RDSdec::syndrome(b ^ (3UL << k)) != syn[o]);
+            }
+        }
+    }
+}
+
+//-------------------Stream Section-----------------------------
+
+static void testClean_()
+{
+    QN800x_RDSdec dec;
+    uint16_t got = decode_(dec, 37, -1, -1);         // Starts in the middle of block B
+
+    CHECK(got >= GROUPS - 2);                       // At most the first partial group and the one used to sync are lost
+    CHECK(dec.getSyncs() == 1);
+    CHECK(dec.getBadBlocks() == 0);
+    CHECK(memcmp(dec.group(), grp[GROUPS - 1], 8) == 0);
+}
+
+static void testBitErrors_()
+{
+    uint32_t at[4] = {20 * 104 + 3, 31 * 104 + 25, 31 * 104 + 26, 45 * 104 + 103}; // Inside a block, last and first bit of one, last of a group
+
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        QN800x_RDSdec dec;
+        uint16_t got = decode_(dec, 0, at[i], -1);
+
+        CHECK(dec.getSyncs() == 1);                 // The block sync holds
+        CHECK(dec.getBadBlocks() >= 1 && dec.getBadBlocks() <= 2);
+        CHECK(got >= GROUPS - 4 && got <= GROUPS - 2); // The hit groups are dropped, not passed on
+        CHECK(memcmp(dec.group(), grp[GROUPS - 1], 8) == 0);
+    }
+}
+
+static void testBitSlip_()
+{
+    QN800x_RDSdec dec;
+    int16_t first = -1;
+    uint32_t slip = 20 * 104 + 50;                  // One bit lost in block B of group 20
+
+    uint16_t got = decode_(dec, 0, -1, slip, &first, slip);
+
+    CHECK(dec.getSyncs() == 2);                     // Lost the block boundaries and found them again
+    CHECK(dec.getBadBlocks() >= RDS_SYNC_LOSS);
+    CHECK(first >= 21 && first <= 24);              // Back within a few groups
+    CHECK(got >= GROUPS - (first - 19) - 1);
+    CHECK(memcmp(dec.group(), grp[GROUPS - 1], 8) == 0);
+}
+
+//-------------------Loopback Section---------------------------
+
+static QN800x_RDSenc loopEnc;
+static QN800x_RDSdec loopDec;
+static char rxPS[9];                                // PS as a receiver puts it together
+static char rxRT[65];                               // RT as a receiver puts it together
+static uint8_t psSeen;                              // Bit n: PS segment n received
+static uint16_t rtSeen;                             // Bit n: RT segment n received
+static int8_t rxAB;                                 // RT A/B flag of the last 2A group, -1 = none yet
+static uint16_t badPI;                              // Groups with another PI
+
+static void rx_(const uint8_t group[8], uint32_t t) // Every group the simulated QN800x puts on air
+{
+    (void) t;
+    uint8_t bits[RDS_GROUP_BYTES];
+    loopEnc.encode(group, bits);
+
+    for (uint8_t k = 0; k < RDS_GROUP_BYTES; k++)
+    {
+        if (!loopDec.putByte(bits[k])) continue;
+
+        const uint8_t *g = loopDec.group();
+        if (g[0] != 0xC2 || g[1] != 0x01) badPI++;
+
+        uint8_t type = g[2] >> 3;                   // Type * 2 + B
+        if (type == 0)                              // 0A: 2 PS characters
+        {
+            uint8_t a = g[3] & 0x03;
+            rxPS[2 * a] = g[6];
+            rxPS[2 * a + 1] = g[7];
+            bitSet(psSeen, a);
+        }
+        if (type == 4)                              // 2A: 4 RT characters
+        {
+            uint8_t a = g[3] & 0x0F;
+            int8_t ab = (g[3] >> 4) & 1;
+            if (ab != rxAB) {memset(rxRT, 0, sizeof(rxRT)); rtSeen = 0; rxAB = ab;} // A/B changed: receivers clear the display
+            memcpy(rxRT + 4 * a, g + 4, 4);
+            bitSet(rtSeen, a);
+        }
+    }
+}
+
+static void rxClear_()
+{
+    memset(rxPS, 0, sizeof(rxPS));
+    memset(rxRT, 0, sizeof(rxRT));
+    psSeen = 0;
+    rtSeen = 0;
+}
+
+static void run_(QN800x_TX &tx, uint32_t ms)
+{
+    uint32_t t0 = millis();
+    while (millis() - t0 < ms) {tx.tick();}
+}
+
+static void testLoopback_()
+{
+    QN800x_SimBus sim;
+    sim.useVirtualTime(true);
+    sim.onGroup = rx_;
+    QN800x_TX tx(sim);
+
+    QN800x_Setup setup;
+    CHECK(tx.begin(setup));
+
+    rxClear_();
+    rxAB = -1;
+    badPI = 0;
+
+    char ps[] = "LOOPBACK";
+    char rt[] = "Hello loopback";                   // 14 characters, the 0x0D makes 4 segments
+    tx.setRDS_PI(0xC201);
+    tx.loadRDS_PS(ps, 5, false, true);
+    tx.loadRDS_RT(rt, 5, false);
+    tx.startCarousel();
+    run_(tx, 5000);
+
+    CHECK(loopDec.getSyncs() == 1);
+    CHECK(loopDec.getBadBlocks() == 0);
+    CHECK(loopDec.getGroups() + 2 >= sim.groupsSent);
+    CHECK(badPI == 0);
+    CHECK(psSeen == 0x0F);
+    CHECK(strcmp(rxPS, "LOOPBACK") == 0);
+    CHECK(rtSeen == 0x000F);                        // Only the needed segments
+    CHECK(memcmp(rxRT, "Hello loopback\r", 15) == 0); // Closed with 0x0D
+    CHECK(rxAB == 0);
+
+    char rt2[] = "Next title";                      // A/B flips, receivers start over
+    tx.loadRDS_RT(rt2, 5, true);
+    tx.rushRT();
+    run_(tx, 5000);
+
+    CHECK(rxAB == 1);
+    CHECK(rtSeen == 0x0007);
+    CHECK(memcmp(rxRT, "Next title\r", 11) == 0);
+    CHECK(strcmp(rxPS, "LOOPBACK") == 0);
+    CHECK(loopDec.getBadBlocks() == 0);
+    CHECK(badPI == 0);
+}
+
+int main()
+{
+    makeGroups_();
+    makeStream_();
+
+    testBlocks_();
+    testClean_();
+    testBitErrors_();
+    testBitSlip_();
+    testLoopback_();
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}